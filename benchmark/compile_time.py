@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Compile-time benchmark of the amat template interface.
+
+Compiles a translation unit that instantiates amat::match, amat::search,
+amat::find and amat::match_groups for PATTERNS distinct patterns of
+SYMBOLS symbols each, and one that instantiates a single pattern, which
+emits the library code every pattern shares, then reports the difference
+in wall time and peak memory per added pattern for each compiler.
+
+usage: compile_time.py [--symbols N] [--patterns N] [--flags=FLAGS] CXX...
+"""
+
+import argparse
+import os
+import pathlib
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def pattern(index, symbols):
+    """A pattern of `symbols' symbols: literals, classes and operators."""
+    parts = []
+    count = 0
+    while count < symbols:
+        parts.append("(a%d|[b-z]x)*" % (index % 10))
+        count += 9
+    return "".join(parts)
+
+
+def source(patterns, symbols):
+    lines = ["#include <amat/amat.h>", "", "int main(int argc, char** argv)",
+             "{", "    std::string_view input = argv[0];", "    int n = 0;"]
+    for index in range(patterns):
+        literal = '"%s"' % pattern(index, symbols)
+        lines += [
+            "    n += amat::match<%s>(input);" % literal,
+            "    n += amat::search<%s>(input);" % literal,
+            "    n += amat::find<%s>(input).has_value();" % literal,
+            "    n += amat::match_groups<%s>(input).has_value();" % literal,
+        ]
+    lines += ["    return n + argc;", "}", ""]
+    return "\n".join(lines)
+
+
+def compile_once(compiler, flags, path):
+    """Wall time in seconds and peak resident memory in MiB."""
+    command = [compiler, *flags, "-c", str(path), "-o", os.devnull]
+    start = time.perf_counter()
+    process = subprocess.Popen(command)
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    if os.waitstatus_to_exitcode(status) != 0:
+        sys.exit("compile_time: %s failed" % " ".join(command))
+    # ru_maxrss is in KiB on Linux and in bytes on macOS
+    scale = 1 << 20 if sys.platform == "darwin" else 1 << 10
+    return elapsed, usage.ru_maxrss / scale
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--symbols", type=int, default=1000)
+    parser.add_argument("--patterns", type=int, default=8)
+    parser.add_argument("--include", default=str(
+        pathlib.Path(__file__).resolve().parent.parent / "include"))
+    parser.add_argument("--flags", default="-std=c++20 -O2")
+    parser.add_argument("compilers", nargs="+")
+    arguments = parser.parse_args()
+    flags = [*arguments.flags.split(), "-I" + arguments.include]
+
+    with tempfile.TemporaryDirectory() as directory:
+        single = pathlib.Path(directory) / "single.cc"
+        patterns = pathlib.Path(directory) / "patterns.cc"
+        single.write_text(source(1, arguments.symbols))
+        patterns.write_text(source(1 + arguments.patterns, arguments.symbols))
+
+        print("%-12s %14s %14s %14s" % ("compiler", "baseline",
+                                        "per pattern", "peak memory"))
+        for compiler in arguments.compilers:
+            base_time, base_memory = compile_once(compiler, flags, single)
+            total_time, total_memory = compile_once(compiler, flags, patterns)
+            print("%-12s %13.2fs %13.3fs %11.1fMiB (%+.1f)" % (
+                pathlib.Path(compiler).name, base_time,
+                (total_time - base_time) / arguments.patterns, total_memory,
+                total_memory - base_memory))
+
+
+if __name__ == "__main__":
+    main()
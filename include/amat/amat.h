@@ -1,9 +1,23 @@
 #pragma once
 
-#include <amat/helpers.h>
+#include <array>
+#include <optional>
+
+#include <amat/ast.h>
+#include <amat/backtrack.h>
+#include <amat/bytecode.h>
+#include <amat/dfa.h>
+#include <amat/export.h>
+#include <amat/glushkov.h>
 #include <amat/lexer.h>
+#include <amat/literal.h>
 #include <amat/nfa.h>
+#include <amat/onepass.h>
 #include <amat/parser.h>
+#include <amat/pike.h>
+#include <amat/program.h>
+#include <amat/serialize.h>
+#include <amat/stats.h>
 #include <amat/subset.h>
 #include <amat/tokens.h>
 
@@ -18,15 +32,12 @@ template<std::size_t N>
 struct Regular_Expression_String
 {
     char r[N]{};
+    // a plain loop, so each length instantiates no range adaptors
     constexpr Regular_Expression_String(char const (&str)[N])
     {
-        std::string_view str_ = str;
-        auto regexp_view{ str_ |
-                          std::views::transform([](char c) -> NFA::Input {
-                              return static_cast<NFA::Input>(c);
-                          }) };
-
-        std::ranges::copy(regexp_view, r);
+        for (std::size_t i = 0; i < N; i++) {
+            r[i] = str[i];
+        }
     };
 };
 
@@ -41,28 +52,69 @@ constexpr auto operator"" _r()
 // << core library functions >>
 ///////////////////////////////
 
-template<literals::Regular_Expression_String RegExp>
-void
-print()
+namespace util {
+
+/**
+ * Program of a regular expression literal, compiled on first use and
+ * shared by every function below: each pattern instantiates one static
+ * and one call into the non-template `program' constructor.
+ */
+template<literals::Regular_Expression_String RegExp, Flags Options>
+program const&
+compiled()
 {
-    constexpr auto content = RegExp.r;
-    util::print_NFA(util::construct_NFA_from_regular_expression(content),
-                    content);
+    static program const compiled{ RegExp.r, Options };
+    return compiled;
 }
 
-template<literals::Regular_Expression_String RegExp>
+} // namespace util
+
+template<literals::Regular_Expression_String RegExp,
+         Flags Options = Flags::none>
 bool
 match(std::string_view str)
 {
-    constexpr auto content = RegExp.r;
-    auto nfa = util::construct_NFA_from_regular_expression(content);
-    util::Simulator dfa{ nfa };
-    dfa.add_state(nfa.start);
-    for (auto const& c : str) {
-        dfa.get_next_closed_transition(c);
-    }
-
-    return std::ranges::equal(dfa.old_states, nfa.accepted);
+    return util::compiled<RegExp, Options>().match(str);
+}
+
+/**
+ * True if the regular expression matches anywhere in `str'.
+ */
+template<literals::Regular_Expression_String RegExp,
+         Flags Options = Flags::none>
+bool
+search(std::string_view str)
+{
+    return util::compiled<RegExp, Options>().search(str);
+}
+
+/**
+ * Span of the leftmost-longest match of the regular expression in `str',
+ * or with `Policy::earliest', of the match that ends first.
+ */
+template<literals::Regular_Expression_String RegExp,
+         Flags Options = Flags::none,
+         Policy Match = Policy::leftmost_longest>
+std::optional<Span>
+find(std::string_view str)
+{
+    return util::compiled<RegExp, Options>().template find<Match>(str);
+}
+
+/**
+ * Match and extract the span of each parenthesized group, numbered by
+ * its opening parenthesis.
+ */
+template<literals::Regular_Expression_String RegExp,
+         Flags Options = Flags::none>
+std::optional<std::array<Span, count_capture_groups(RegExp.r)>>
+match_groups(std::string_view str)
+{
+    std::array<Span, count_capture_groups(RegExp.r)> groups{};
+    if (!util::compiled<RegExp, Options>().match(str, groups))
+        return std::nullopt;
+
+    return groups;
 }
 
 } // namespace amat
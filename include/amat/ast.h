@@ -0,0 +1,450 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <amat/parser.h>
+
+namespace amat {
+
+/**
+ * Syntax tree of an expression as one array of nodes, which refer to
+ * their operands by index: a tree is a single allocation, and a pass may
+ * add nodes without moving the others. Each node is an `Item' of the
+ * postfix form, with its operand in `left', and the second one of a
+ * concatenation or a union in `right'. Nodes that a pass leaves out of
+ * the tree stay in the array until it is written back as postfix.
+ */
+struct Ast
+{
+    using Index = std::uint32_t;
+
+    static constexpr Index none = ~Index{ 0 };
+
+    struct Node
+    {
+        Item item;
+        Index left = none;
+        Index right = none;
+    };
+
+    std::vector<Node> nodes{};
+    Index root = none;
+
+  public:
+    inline Node const& operator[](Index index) const
+    {
+        return this->nodes[index];
+    }
+    inline Item::Type type(Index index) const
+    {
+        return this->nodes[index].item.type;
+    }
+
+    Index add(Item item, Index left = none, Index right = none)
+    {
+        this->nodes.push_back({ std::move(item), left, right });
+        return static_cast<Index>(this->nodes.size() - 1);
+    }
+};
+
+namespace util {
+
+// forward declarations
+Ast
+construct_ast_from_postfix(Postfix const&);
+Postfix
+construct_postfix_from_ast(Ast const&);
+void
+simplify(Ast&, bool captures = true);
+Postfix
+simplify(Postfix const&, bool captures = true);
+
+/**
+ * Tree of `Parser::postfix()', with each operand before the operators
+ * that take it, as in the postfix form.
+ */
+inline Ast
+construct_ast_from_postfix(Postfix const& postfix)
+{
+    Ast ast{};
+    ast.nodes.reserve(postfix.size());
+    std::vector<Ast::Index> operands{};
+    auto pop = [&operands]() {
+        auto top = operands.back();
+        operands.pop_back();
+        return top;
+    };
+    for (auto const& item : postfix) {
+        switch (item.type) {
+            case Item::Type::T_SET:
+            case Item::Type::T_ASSERTION:
+                operands.push_back(ast.add(item));
+                break;
+            case Item::Type::T_CONCAT:
+            case Item::Type::T_UNION: {
+                auto right = pop();
+                auto left = pop();
+                operands.push_back(ast.add(item, left, right));
+                break;
+            }
+            default:
+                operands.push_back(ast.add(item, pop()));
+                break;
+        }
+    }
+    if (operands.size())
+        ast.root = operands.back();
+    return ast;
+}
+
+/**
+ * Postfix form of the nodes reachable from the root.
+ */
+inline Postfix
+construct_postfix_from_ast(Ast const& ast)
+{
+    Postfix output{};
+    if (ast.root == Ast::none)
+        return output;
+    // nodes to write once their operands are
+    std::vector<std::pair<Ast::Index, bool>> stack{ { ast.root, false } };
+    while (stack.size()) {
+        auto [index, ready] = stack.back();
+        stack.pop_back();
+        if (ready) {
+            output.push_back(ast[index].item);
+            continue;
+        }
+        stack.push_back({ index, true });
+        if (ast[index].right != Ast::none)
+            stack.push_back({ ast[index].right, false });
+        if (ast[index].left != Ast::none)
+            stack.push_back({ ast[index].left, false });
+    }
+    return output;
+}
+
+namespace detail {
+
+inline bool
+is_repetition(Item::Type type)
+{
+    return type == Item::Type::T_KLEENE_STAR or
+           type == Item::Type::T_PLUS or type == Item::Type::T_OPTIONAL;
+}
+
+inline bool
+same_item(Item const& a, Item const& b)
+{
+    return a.type == b.type and a.set == b.set and
+           a.codes.ranges == b.codes.ranges and
+           a.bounds.min == b.bounds.min and a.bounds.max == b.bounds.max and
+           a.assertion == b.assertion;
+}
+
+/**
+ * True if the trees at `a' and `b' are equal, compared with a stack of
+ * node pairs rather than recursion, so that deep trees fit.
+ */
+inline bool
+same_tree(Ast const& ast, Ast::Index a, Ast::Index b)
+{
+    std::vector<std::pair<Ast::Index, Ast::Index>> stack{ { a, b } };
+    while (stack.size()) {
+        auto [x, y] = stack.back();
+        stack.pop_back();
+        if (x == y)
+            continue;
+        if (x == Ast::none or y == Ast::none or
+            !same_item(ast[x].item, ast[y].item))
+            return false;
+        stack.push_back({ ast[x].right, ast[y].right });
+        stack.push_back({ ast[x].left, ast[y].left });
+    }
+    return true;
+}
+
+/**
+ * Operands of the chain of `type' operators at `index', left to right.
+ */
+inline void
+flatten(Ast const& ast,
+        Ast::Index index,
+        Item::Type type,
+        std::vector<Ast::Index>& output)
+{
+    std::vector<Ast::Index> stack{ index };
+    while (stack.size()) {
+        index = stack.back();
+        stack.pop_back();
+        if (ast.type(index) != type) {
+            output.push_back(index);
+            continue;
+        }
+        stack.push_back(ast[index].right);
+        stack.push_back(ast[index].left);
+    }
+}
+
+inline Ast::Index
+fold(Ast& ast, std::span<Ast::Index const> operands, Item::Type type)
+{
+    Ast::Index result = operands.front();
+    for (auto operand : operands.subspan(1))
+        result = ast.add({ type }, result, operand);
+    return result;
+}
+
+inline Ast::Index
+head(Ast const& ast, Ast::Index index)
+{
+    while (ast.type(index) == Item::Type::T_CONCAT)
+        index = ast[index].left;
+    return index;
+}
+
+inline Ast::Index
+tail(Ast const& ast, Ast::Index index)
+{
+    while (ast.type(index) == Item::Type::T_CONCAT)
+        index = ast[index].right;
+    return index;
+}
+
+/**
+ * End of the run of alternatives from `i' that begin, or end, with the
+ * same operand as it, as found by `edge'. With `captures', the operand
+ * must be a single set or assertion, so that neither the groups nor the
+ * priority of the paths change.
+ */
+template<class Edge>
+std::size_t
+same_edge_run(Ast const& ast,
+              std::vector<Ast::Index> const& alternatives,
+              std::size_t i,
+              bool captures,
+              Edge edge)
+{
+    auto const operand = edge(ast, alternatives[i]);
+    auto const type = ast.type(operand);
+    std::size_t end = i + 1;
+    if (!captures or type == Item::Type::T_SET or
+        type == Item::Type::T_ASSERTION) {
+        while (end < alternatives.size() and
+               same_tree(ast, operand, edge(ast, alternatives[end])))
+            end++;
+    }
+    return end;
+}
+
+/**
+ * Number of operands, counted from the edge and including the one the
+ * run was found by, that all of `factors' share and that can be taken
+ * out of them together, each leaving at least one operand behind. They
+ * are factored at once rather than one per level of recursion, so long
+ * shared prefixes and suffixes do not deepen the stack.
+ */
+template<class Operand>
+std::size_t
+shared_operands(Ast const& ast,
+                std::vector<std::vector<Ast::Index>> const& factors,
+                bool captures,
+                Operand operand)
+{
+    std::size_t shared = 1;
+    for (;; shared++) {
+        for (auto const& operands : factors) {
+            if (operands.size() <= shared + 1)
+                return shared;
+            auto const index = operand(operands, shared);
+            auto const type = ast.type(index);
+            if ((captures and type != Item::Type::T_SET and
+                 type != Item::Type::T_ASSERTION) or
+                !same_tree(ast, operand(factors.front(), shared), index))
+                return shared;
+        }
+    }
+}
+
+// forward declaration
+Ast::Index
+factor_union(Ast&, std::vector<Ast::Index> const&, bool);
+
+/**
+ * Union of `alternatives' with the consecutive ones that end with the
+ * same operand factored, e.g. `abc|xbc' -> `(a|x)bc', as
+ * `factor_union' does for the operand they begin with.
+ */
+inline Ast::Index
+factor_suffixes(Ast& ast,
+                std::vector<Ast::Index> const& alternatives,
+                bool captures)
+{
+    std::vector<Ast::Index> output{};
+    for (std::size_t i = 0; i < alternatives.size();) {
+        auto const last = tail(ast, alternatives[i]);
+        std::size_t end = same_edge_run(ast, alternatives, i, captures, tail);
+        std::vector<std::vector<Ast::Index>> factors{};
+        bool shortest = false;
+        for (std::size_t k = i; k < end; k++) {
+            factors.emplace_back();
+            flatten(
+              ast, alternatives[k], Item::Type::T_CONCAT, factors.back());
+            if (factors.back().size() == 1) {
+                shortest = true;
+                end = k + 1;
+                break;
+            }
+        }
+        if (end - i == 1) {
+            output.push_back(alternatives[i]);
+            i = end;
+            continue;
+        }
+        if (shortest)
+            factors.pop_back();
+        auto const shared = shared_operands(
+          ast, factors, captures, [](auto const& operands, std::size_t k) {
+              return operands[operands.size() - 1 - k];
+          });
+        std::vector<Ast::Index> fronts{};
+        for (auto const& operands : factors) {
+            fronts.push_back(fold(ast,
+                                  std::span{ operands }.first(
+                                    operands.size() - shared),
+                                  Item::Type::T_CONCAT));
+        }
+        auto body = factor_union(ast, fronts, captures);
+        auto const& operands = factors.front();
+        for (auto k = operands.size() - shared; k < operands.size() - 1; k++)
+            body = ast.add({ Item::Type::T_CONCAT }, body, operands[k]);
+        if (shortest)
+            body = ast.add({ Item::Type::T_OPTIONAL }, body);
+        output.push_back(ast.add({ Item::Type::T_CONCAT }, body, last));
+        i = end;
+    }
+    return fold(ast, output, Item::Type::T_UNION);
+}
+
+/**
+ * Union of `alternatives' with the consecutive ones that begin with the
+ * same operand factored, e.g. `abc|abd|e' -> `ab(c|d)|e', recursively,
+ * so they form a trie, then those that end alike, see `factor_suffixes'.
+ * Alternatives are kept in order; an alternative made of the operand
+ * alone is only factored as the last of its run, as an optional that
+ * keeps it after the longer ones, like `ab|a' -> `ab?'.
+ */
+inline Ast::Index
+factor_union(Ast& ast,
+             std::vector<Ast::Index> const& alternatives,
+             bool captures)
+{
+    std::vector<Ast::Index> output{};
+    for (std::size_t i = 0; i < alternatives.size();) {
+        auto const first = head(ast, alternatives[i]);
+        std::size_t end = same_edge_run(ast, alternatives, i, captures, head);
+        std::vector<std::vector<Ast::Index>> factors{};
+        bool shortest = false;
+        for (std::size_t k = i; k < end; k++) {
+            factors.emplace_back();
+            flatten(
+              ast, alternatives[k], Item::Type::T_CONCAT, factors.back());
+            if (factors.back().size() == 1) {
+                shortest = true;
+                end = k + 1;
+                break;
+            }
+        }
+        if (end - i == 1) {
+            output.push_back(alternatives[i]);
+            i = end;
+            continue;
+        }
+        if (shortest)
+            factors.pop_back();
+        auto const shared = shared_operands(
+          ast, factors, captures, [](auto const& operands, std::size_t k) {
+              return operands[k];
+          });
+        std::vector<Ast::Index> rests{};
+        for (auto const& operands : factors) {
+            rests.push_back(fold(ast,
+                                 std::span{ operands }.subspan(shared),
+                                 Item::Type::T_CONCAT));
+        }
+        auto body = factor_union(ast, rests, captures);
+        auto const& operands = factors.front();
+        for (auto k = shared - 1; k > 0; k--)
+            body = ast.add({ Item::Type::T_CONCAT }, operands[k], body);
+        if (shortest)
+            body = ast.add({ Item::Type::T_OPTIONAL }, body);
+        output.push_back(ast.add({ Item::Type::T_CONCAT }, first, body));
+        i = end;
+    }
+    return factor_suffixes(ast, output, captures);
+}
+
+} // namespace detail
+
+/**
+ * Rewrite `ast' into an equivalent and smaller tree:
+ * - nested repetitions are flattened, e.g. `a+*' -> `a*';
+ * - without `captures', groups are removed, as only the language of the
+ *   expression is left to match;
+ * - unions factor the operands their consecutive alternatives begin or
+ *   end with, see `detail::factor_union'.
+ */
+inline void
+simplify(Ast& ast, bool captures)
+{
+    using Type = Item::Type;
+    auto const size = static_cast<Ast::Index>(ast.nodes.size());
+
+    // operands come before their operators, so each node sees them done
+    for (Ast::Index i = 0; i < size; i++) {
+        auto const type = ast.type(i);
+        if (type == Type::T_GROUP and !captures) {
+            Ast::Node operand = ast[ast[i].left];
+            ast.nodes[i] = std::move(operand);
+        } else if (detail::is_repetition(type) and
+                   detail::is_repetition(ast.type(ast[i].left))) {
+            auto const inner = ast.type(ast[i].left);
+            auto flat = type == inner and type != Type::T_KLEENE_STAR
+                          ? type
+                          : Type::T_KLEENE_STAR;
+            ast.nodes[i] = { { flat }, ast[ast[i].left].left };
+        }
+    }
+
+    // unions within a union are factored with it
+    std::vector<bool> nested(size, false);
+    for (Ast::Index i = 0; i < size; i++) {
+        if (ast.type(i) != Type::T_UNION)
+            continue;
+        for (auto operand : { ast[i].left, ast[i].right })
+            nested[operand] = ast.type(operand) == Type::T_UNION;
+    }
+    for (Ast::Index i = 0; i < size; i++) {
+        if (ast.type(i) != Type::T_UNION or nested[i])
+            continue;
+        std::vector<Ast::Index> alternatives{};
+        detail::flatten(ast, i, Type::T_UNION, alternatives);
+        auto factored = detail::factor_union(ast, alternatives, captures);
+        Ast::Node node = ast[factored];
+        ast.nodes[i] = std::move(node);
+    }
+}
+
+inline Postfix
+simplify(Postfix const& postfix, bool captures)
+{
+    auto ast = construct_ast_from_postfix(postfix);
+    simplify(ast, captures);
+    return construct_postfix_from_ast(ast);
+}
+
+} // namespace util
+} // namespace amat
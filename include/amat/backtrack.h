@@ -0,0 +1,142 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <amat/bytecode.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * Backtracking execution of `amat::util::Bytecode' in leftmost-first
+ * priority order. A bitmap of visited (instruction, offset) pairs lets
+ * every pair run at most once, which bounds the search by the product of
+ * the program and input sizes; in a counted loop, the instruction is
+ * told apart by its count, see `Bytecode::key'.
+ */
+class Backtracker
+{
+  public:
+    // visited bitmap budget, in bits
+    static constexpr std::size_t max_visited = 256 * 1024;
+
+    Backtracker() = delete;
+    explicit Backtracker(Bytecode const& bytecode)
+      : bytecode_(bytecode)
+    {
+    }
+
+  public:
+    static bool fits(Bytecode const& bytecode, std::size_t length)
+    {
+        return bytecode.key_count() * (length + 1) <= max_visited;
+    }
+
+    bool match(std::string_view str, std::span<Span> groups)
+    {
+        this->width_ = str.size() + 1;
+        this->visited_.assign(this->bytecode_.key_count() * this->width_,
+                              false);
+        this->slots_.assign(this->bytecode_.slots(), Span::npos);
+        this->jobs_.clear();
+        this->jobs_.push_back({ this->bytecode_.start, 0, 0, false });
+
+        while (this->jobs_.size()) {
+            Job job = this->jobs_.back();
+            this->jobs_.pop_back();
+            if (job.restore) {
+                this->slots_[job.pc] = job.offset;
+                continue;
+            }
+            if (this->run_(str, job.pc, job.count, job.offset)) {
+                for (std::size_t i = 0; i < groups.size(); i++) {
+                    groups[i] = { this->slots_[i * 2], this->slots_[i * 2 + 1] };
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    struct Job
+    {
+        Instruction::Target pc;
+        Instruction::Target count;
+        std::size_t offset;
+        bool restore;
+    };
+
+    bool run_(std::string_view str,
+              Instruction::Target pc,
+              Instruction::Target count,
+              std::size_t offset)
+    {
+        while (true) {
+            auto visited =
+              this->visited_[this->bytecode_.key(pc, count) * this->width_ +
+                             offset];
+            if (visited)
+                return false;
+            visited = true;
+
+            auto const& instruction = this->bytecode_[pc];
+            switch (instruction.opcode) {
+                case Instruction::Opcode::character:
+                case Instruction::Opcode::set:
+                    if (offset == str.size() or
+                        !this->bytecode_.consumes(
+                          instruction, static_cast<NFA::Input>(str[offset])))
+                        return false;
+                    util::count(&stats::bytes_scanned);
+                    pc = instruction.x;
+                    offset++;
+                    break;
+                case Instruction::Opcode::split:
+                    this->jobs_.push_back(
+                      { instruction.y, count, offset, false });
+                    pc = instruction.x;
+                    break;
+                case Instruction::Opcode::jump:
+                    pc = instruction.x;
+                    break;
+                case Instruction::Opcode::assertion:
+                    if (!this->bytecode_.holds(instruction,
+                                               Context::at(str, offset)))
+                        return false;
+                    pc = instruction.x;
+                    break;
+                case Instruction::Opcode::save:
+                    this->jobs_.push_back(
+                      { instruction.y, 0, this->slots_[instruction.y], true });
+                    this->slots_[instruction.y] = offset;
+                    pc = instruction.x;
+                    break;
+                case Instruction::Opcode::repeat:
+                case Instruction::Opcode::increment:
+                case Instruction::Opcode::leave: {
+                    auto next = this->bytecode_.step_count(instruction, count);
+                    if (!next)
+                        return false;
+                    count = *next;
+                    pc = instruction.x;
+                    break;
+                }
+                case Instruction::Opcode::match:
+                    return offset == str.size();
+            }
+        }
+    }
+
+  private:
+    Bytecode const& bytecode_;
+    std::size_t width_ = 0;
+    std::vector<bool> visited_{};
+    std::vector<std::size_t> slots_{};
+    std::vector<Job> jobs_{};
+};
+
+} // namespace util
+} // namespace amat
@@ -0,0 +1,661 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stack>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <amat/nfa.h>
+#include <amat/parser.h>
+#include <amat/stats.h>
+
+namespace amat {
+
+/**
+ * Offsets [begin, end) of a capture group in the input; `npos' when the
+ * group did not take part in the match.
+ */
+struct Span
+{
+    static constexpr std::size_t npos = std::string_view::npos;
+
+    std::size_t begin = npos;
+    std::size_t end = npos;
+
+  public:
+    constexpr bool matched() const { return this->begin != npos; }
+    constexpr std::size_t size() const { return this->end - this->begin; }
+
+    friend constexpr bool operator==(Span const&, Span const&) = default;
+};
+
+/**
+ * Match reported by a search: the leftmost-longest, as in POSIX, e.g. to
+ * tokenize, or the one that ends first, found as soon as an accept state
+ * is reached, e.g. to validate.
+ */
+enum class Policy
+{
+    leftmost_longest,
+    earliest
+};
+
+namespace util {
+
+constexpr bool
+is_word_byte(NFA::Input c)
+{
+    return (c >= '0' and c <= '9') or (c >= 'a' and c <= 'z') or
+           (c >= 'A' and c <= 'Z') or c == '_';
+}
+
+/**
+ * Input around an offset, as seen by an assertion.
+ */
+struct Context
+{
+    bool begin = false;
+    bool end = false;
+    bool word_before = false;
+    bool word_after = false;
+
+  public:
+    static constexpr Context at(std::string_view str, std::size_t offset)
+    {
+        return { offset == 0,
+                 offset == str.size(),
+                 offset > 0 and
+                   is_word_byte(static_cast<NFA::Input>(str[offset - 1])),
+                 offset < str.size() and
+                   is_word_byte(static_cast<NFA::Input>(str[offset])) };
+    }
+};
+
+/**
+ * True for an assertion that depends on the input after the offset.
+ */
+constexpr bool
+looks_ahead(Assertion assertion)
+{
+    return assertion != Assertion::begin_text;
+}
+
+constexpr bool
+holds(Assertion assertion, Context context)
+{
+    switch (assertion) {
+        case Assertion::begin_text:
+            return context.begin;
+        case Assertion::end_text:
+            return context.end;
+        case Assertion::word_boundary:
+            return context.word_before != context.word_after;
+        case Assertion::not_word_boundary:
+            return context.word_before == context.word_after;
+    }
+    return false;
+}
+
+struct Instruction
+{
+    using Target = std::uint32_t;
+
+    enum class Opcode : unsigned char
+    {
+        character,
+        set,
+        split,
+        jump,
+        save,
+        assertion,
+        match,
+        // loop of a counted repetition: enter its body, count one more
+        // pass, and leave it, see `Bytecode::counters'
+        repeat,
+        increment,
+        leave
+    };
+
+    Opcode opcode;
+    NFA::Input symbol = Epsilon;
+    // next instruction(s): `x' is preferred over `y' by a split, `y'
+    // is the slot written by a save, the byte set index of a set, the
+    // `amat::Assertion' of an assertion and the counter of a loop
+    Target x = 0;
+    Target y = 0;
+};
+
+/**
+ * Thompson NFA compiled into an instruction array, with `save'
+ * instructions recording capture group boundaries into slots 2k, 2k+1.
+ */
+struct Bytecode
+{
+    // default cap on instructions, i.e. NFA states, see `amat::limits'
+    static constexpr std::size_t max_size = std::size_t{ 1 } << 18;
+
+    /**
+     * Counted repetition kept as a loop over one copy of its body, whose
+     * instructions are [begin, end): a thread in the loop carries the
+     * number of passes done, up to `cap()', so each instruction there
+     * stands for one per count, as its copies would when unrolled.
+     */
+    struct Counter
+    {
+        Bounds bounds;
+        Instruction::Target begin;
+        Instruction::Target end;
+
+      public:
+        inline Instruction::Target cap() const
+        {
+            return this->bounds.max == Bounds::unbounded ? this->bounds.min
+                                                         : this->bounds.max;
+        }
+    };
+
+    std::vector<Instruction> instructions{};
+    std::vector<Byte_Set> sets{};
+    Instruction::Target start = 0;
+    std::size_t groups = 0;
+    // with counters, the first key of each instruction and then their
+    // total, see `key'
+    std::vector<Counter> counters{};
+    std::vector<std::size_t> keys{};
+
+  public:
+    /**
+     * True for a character or set instruction that takes `c'.
+     */
+    inline bool consumes(Instruction const& instruction, NFA::Input c) const
+    {
+        switch (instruction.opcode) {
+            case Instruction::Opcode::character:
+                return instruction.symbol == c;
+            case Instruction::Opcode::set:
+                return this->sets[instruction.y][c];
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * True for an assertion instruction that holds in `context'.
+     */
+    inline bool holds(Instruction const& instruction, Context context) const
+    {
+        return instruction.opcode == Instruction::Opcode::assertion and
+               util::holds(static_cast<Assertion>(instruction.y), context);
+    }
+
+    /**
+     * Count of a thread with `count' once past a loop instruction, or
+     * std::nullopt when the loop holds it back: `repeat' below the
+     * maximum, `leave' from the minimum on, where the count is cleared.
+     */
+    inline std::optional<Instruction::Target>
+    step_count(Instruction const& instruction, Instruction::Target count) const
+    {
+        auto const& counter = this->counters[instruction.y];
+        switch (instruction.opcode) {
+            case Instruction::Opcode::repeat:
+                if (counter.bounds.max != Bounds::unbounded and
+                    count >= counter.bounds.max)
+                    return std::nullopt;
+                return count;
+            case Instruction::Opcode::increment:
+                return std::min(count + 1, counter.cap());
+            default:
+                if (count < counter.bounds.min)
+                    return std::nullopt;
+                return 0;
+        }
+    }
+
+    /**
+     * Dense index of a thread at `pc' with `count', for the engines that
+     * keep one entry per thread: the instruction itself without counters.
+     */
+    inline std::size_t key(Instruction::Target pc,
+                           Instruction::Target count) const
+    {
+        return this->keys.empty() ? pc : this->keys[pc] + count;
+    }
+    inline std::size_t key_count() const
+    {
+        return this->keys.empty() ? this->size() : this->keys.back();
+    }
+
+    inline std::size_t size() const { return this->instructions.size(); }
+    inline std::size_t slots() const { return this->groups * 2; }
+    inline Instruction const& operator[](Instruction::Target pc) const
+    {
+        return this->instructions[pc];
+    }
+};
+
+// forward declarations
+Bytecode
+construct_bytecode_from_regular_expression(std::string_view);
+Bytecode
+construct_bytecode_from_postfix(Postfix const&,
+                                bool reverse = false,
+                                std::size_t max_size = Bytecode::max_size,
+                                bool counted = false);
+std::size_t
+unrolled_size(Postfix const&);
+
+inline Bytecode
+construct_bytecode_from_regular_expression(std::string_view source)
+{
+    Parser parser{ source };
+    return construct_bytecode_from_postfix(parser.postfix());
+}
+
+/**
+ * Compile a strict postfix expression fragment by fragment on a stack;
+ * the dangling exits of a fragment are patched once its successor is
+ * known. Groups are numbered in the order of their opening parenthesis.
+ * A counted repetition is unrolled by copying the instructions of its
+ * operand, which are contiguous from `Fragment::begin'. With `counted',
+ * the innermost ones that would take more than a few copies are instead
+ * kept as a loop on a counter, for the Pike VM and the backtracker: the
+ * enclosing repetitions are unrolled, counters included, and the DFAs
+ * still need the unrolled bytecode. With `reverse', the bytecode takes
+ * the reversed language: concatenations run right to left and `^' and
+ * `$' trade places. Throws once it needs more than `max_size'
+ * instructions, before counted repetitions can blow up.
+ */
+inline Bytecode
+construct_bytecode_from_postfix(Postfix const& postfix,
+                                bool reverse,
+                                std::size_t max_size,
+                                bool counted)
+{
+    using Target = Instruction::Target;
+    using Exit = std::pair<Target, bool>;
+
+    struct Fragment
+    {
+        Target start;
+        std::vector<Exit> exits;
+        // save instructions of the groups within, by opening order; the
+        // copies of a repeated group share its number
+        std::vector<std::vector<Target>> groups;
+        // first instruction emitted for the fragment
+        Target begin;
+        // holds a counted repetition
+        bool counts = false;
+    };
+
+    Bytecode bytecode{};
+    std::stack<Fragment> fragments{};
+
+    auto emit = [&bytecode, max_size](Instruction instruction) -> Target {
+        if (bytecode.instructions.size() >= max_size) {
+            throw std::runtime_error(
+              "could not construct bytecode: more than " +
+              std::to_string(max_size) + " instructions");
+        }
+        bytecode.instructions.push_back(instruction);
+        return static_cast<Target>(bytecode.instructions.size() - 1);
+    };
+    auto patch = [&bytecode](std::vector<Exit> const& exits, Target to) {
+        for (auto const& [pc, second] : exits) {
+            if (second)
+                bytecode.instructions[pc].y = to;
+            else
+                bytecode.instructions[pc].x = to;
+        }
+    };
+    auto pop = [&fragments]() -> Fragment {
+        if (fragments.empty()) {
+            throw std::runtime_error(
+              "could not construct bytecode from the stack");
+        }
+        Fragment fragment = std::move(fragments.top());
+        fragments.pop();
+        return fragment;
+    };
+    auto append = [](auto& to, auto const& from) {
+        to.insert(to.end(), from.begin(), from.end());
+    };
+    auto concat = [&](Fragment left, Fragment const& right) -> Fragment {
+        append(left.groups, right.groups);
+        bool counts = left.counts or right.counts;
+        if (reverse) {
+            patch(right.exits, left.start);
+            return {
+                right.start, left.exits, left.groups, left.begin, counts
+            };
+        }
+        patch(left.exits, right.start);
+        return { left.start, right.exits, left.groups, left.begin, counts };
+    };
+    auto optional = [&](Fragment body) -> Fragment {
+        Target split =
+          emit({ Instruction::Opcode::split, Epsilon, body.start, 0 });
+        body.exits.push_back({ split, true });
+        return { split, body.exits, body.groups, body.begin, body.counts };
+    };
+    auto plus = [&](Fragment body) -> Fragment {
+        Target split =
+          emit({ Instruction::Opcode::split, Epsilon, body.start, 0 });
+        patch(body.exits, split);
+        return { body.start,
+                 { { split, true } },
+                 body.groups,
+                 body.begin,
+                 body.counts };
+    };
+    auto star = [&](Fragment body) -> Fragment {
+        Target split =
+          emit({ Instruction::Opcode::split, Epsilon, body.start, 0 });
+        patch(body.exits, split);
+        return {
+            split, { { split, true } }, body.groups, body.begin, body.counts
+        };
+    };
+    auto copy = [&](Fragment const& fragment, Target end) -> Fragment {
+        Target offset = static_cast<Target>(bytecode.size()) - fragment.begin;
+        // the counters within, in order, get new ones after the last
+        auto& counters = bytecode.counters;
+        auto first = static_cast<Target>(
+          std::ranges::lower_bound(
+            counters, fragment.begin, {}, &Bytecode::Counter::begin) -
+          counters.begin());
+        auto const last = static_cast<Target>(counters.size());
+        auto const shift = last - first;
+        for (auto id = first; id < last and counters[id].begin < end; id++) {
+            auto counter = counters[id];
+            counters.push_back(
+              { counter.bounds, counter.begin + offset, counter.end + offset });
+        }
+        for (auto pc = fragment.begin; pc < end; pc++) {
+            Instruction instruction = bytecode.instructions[pc];
+            instruction.x += offset;
+            switch (instruction.opcode) {
+                case Instruction::Opcode::split:
+                    instruction.y += offset;
+                    break;
+                case Instruction::Opcode::repeat:
+                case Instruction::Opcode::increment:
+                case Instruction::Opcode::leave:
+                    instruction.y += shift;
+                    break;
+                default:
+                    break;
+            }
+            emit(instruction);
+        }
+        Fragment copied{ fragment.start + offset,
+                         {},
+                         {},
+                         fragment.begin + offset,
+                         fragment.counts };
+        for (auto const& [pc, second] : fragment.exits) {
+            copied.exits.push_back({ pc + offset, second });
+        }
+        for (auto const& group : fragment.groups) {
+            copied.groups.emplace_back();
+            for (auto const& open : group) {
+                copied.groups.back().push_back(open + offset);
+            }
+        }
+        return copied;
+    };
+    // body, split (repeat, leave), repeat, increment, leave; a thread
+    // enters at the split with a count of 0 and leaves with 0 again
+    auto loop = [&](Fragment const& body, Bounds bounds) -> Fragment {
+        auto id = static_cast<Target>(bytecode.counters.size());
+        auto split = static_cast<Target>(bytecode.size());
+        emit({ Instruction::Opcode::split, Epsilon, split + 1, split + 3 });
+        emit({ Instruction::Opcode::repeat, Epsilon, body.start, id });
+        Target increment =
+          emit({ Instruction::Opcode::increment, Epsilon, split, id });
+        Target leave = emit({ Instruction::Opcode::leave, Epsilon, 0, id });
+        patch(body.exits, increment);
+        bytecode.counters.push_back({ bounds, body.begin, leave + 1 });
+        return { split, { { leave, false } }, body.groups, body.begin, true };
+    };
+    auto repeat = [&](Fragment const& body, Bounds bounds) -> Fragment {
+        if (bounds.max == 0) {
+            Target skip = emit({ Instruction::Opcode::jump });
+            return {
+                skip, { { skip, false } }, body.groups, body.begin, body.counts
+            };
+        }
+        auto count = bounds.max == Bounds::unbounded
+                       ? std::max(bounds.min, 1u)
+                       : bounds.max;
+        auto end = static_cast<Target>(bytecode.size());
+        if (counted and !body.counts and (count - 1) * (end - body.begin) > 4)
+            return loop(body, bounds);
+        std::vector<Fragment> copies{ body };
+        for (unsigned i = 1; i < count; i++) {
+            copies.push_back(copy(body, end));
+        }
+        if (bounds.max == Bounds::unbounded) {
+            copies.back() =
+              bounds.min ? plus(copies.back()) : star(copies.back());
+            bounds.min = count;
+        }
+        std::optional<Fragment> tail{};
+        for (auto i = count; i > bounds.min; i--) {
+            tail = optional(tail ? concat(copies[i - 1], tail.value())
+                                 : copies[i - 1]);
+        }
+        for (auto i = bounds.min; i > 0; i--) {
+            tail = tail ? concat(copies[i - 1], tail.value()) : copies[i - 1];
+        }
+        // one group number for all copies
+        std::vector<std::vector<Target>> groups = body.groups;
+        for (std::size_t i = 1; i < copies.size(); i++) {
+            for (std::size_t g = 0; g < groups.size(); g++) {
+                append(groups[g], copies[i].groups[g]);
+            }
+        }
+        return { tail->start, tail->exits, groups, body.begin, body.counts };
+    };
+
+    for (auto const& item : util::construct_byte_postfix(postfix)) {
+        switch (item.type) {
+            case Item::Type::T_CONCAT: {
+                Fragment right = pop();
+                Fragment left = pop();
+                fragments.push(concat(std::move(left), right));
+                break;
+            }
+            case Item::Type::T_UNION: {
+                Fragment right = pop();
+                Fragment left = pop();
+                Target split = emit({ Instruction::Opcode::split,
+                                      Epsilon,
+                                      left.start,
+                                      right.start });
+                append(left.exits, right.exits);
+                append(left.groups, right.groups);
+                fragments.push({ split,
+                                 left.exits,
+                                 left.groups,
+                                 left.begin,
+                                 left.counts or right.counts });
+                break;
+            }
+            case Item::Type::T_KLEENE_STAR:
+                fragments.push(star(pop()));
+                break;
+            case Item::Type::T_PLUS:
+                fragments.push(plus(pop()));
+                break;
+            case Item::Type::T_OPTIONAL:
+                fragments.push(optional(pop()));
+                break;
+            case Item::Type::T_REPEAT:
+                fragments.push(repeat(pop(), item.bounds));
+                break;
+            case Item::Type::T_GROUP: {
+                Fragment body = pop();
+                Target open =
+                  emit({ Instruction::Opcode::save, Epsilon, body.start, 0 });
+                Target close = emit({ Instruction::Opcode::save });
+                patch(body.exits, close);
+                body.groups.insert(body.groups.begin(), { open });
+                fragments.push({ open,
+                                 { { close, false } },
+                                 body.groups,
+                                 body.begin,
+                                 body.counts });
+                break;
+            }
+            case Item::Type::T_ASSERTION: {
+                auto assertion = item.assertion;
+                if (reverse and assertion == Assertion::begin_text)
+                    assertion = Assertion::end_text;
+                else if (reverse and assertion == Assertion::end_text)
+                    assertion = Assertion::begin_text;
+                Target pc = emit({ Instruction::Opcode::assertion,
+                                   Epsilon,
+                                   0,
+                                   static_cast<Target>(assertion) });
+                fragments.push({ pc, { { pc, false } }, {}, pc });
+                break;
+            }
+            case Item::Type::T_SET: {
+                Target pc = 0;
+                if (item.set.count() == 1) {
+                    std::size_t c = 0;
+                    while (!item.set[c])
+                        c++;
+                    pc = emit({ Instruction::Opcode::character,
+                                static_cast<NFA::Input>(c) });
+                } else {
+                    pc = emit({ Instruction::Opcode::set,
+                                Epsilon,
+                                0,
+                                static_cast<Target>(bytecode.sets.size()) });
+                    bytecode.sets.push_back(item.set);
+                }
+                fragments.push({ pc, { { pc, false } }, {}, pc });
+                break;
+            }
+        }
+    }
+
+    Target match = emit({ Instruction::Opcode::match });
+    if (fragments.empty()) {
+        bytecode.start = match;
+        return bytecode;
+    }
+    Fragment fragment = pop();
+    if (!fragments.empty()) {
+        throw std::runtime_error(
+          "could not construct bytecode: unbalanced expression");
+    }
+    patch(fragment.exits, match);
+    bytecode.start = fragment.start;
+
+    // each group's save pair is emitted back to back: open, then close
+    for (auto const& group : fragment.groups) {
+        Target slot = static_cast<Target>(bytecode.groups++ * 2);
+        for (auto const& open : group) {
+            bytecode.instructions[open].y = slot;
+            bytecode.instructions[open + 1].y = slot + 1;
+        }
+    }
+
+    // each instruction of a counter's region takes a key per count
+    if (bytecode.counters.size()) {
+        bytecode.keys.assign(bytecode.size() + 1, 0);
+        auto counter = bytecode.counters.begin();
+        for (Target pc = 0; pc < bytecode.size(); pc++) {
+            std::size_t width = 1;
+            if (counter != bytecode.counters.end() and pc >= counter->begin) {
+                width = counter->cap() + std::size_t{ 1 };
+                if (pc + 1 == counter->end)
+                    counter++;
+            }
+            bytecode.keys[pc + 1] = bytecode.keys[pc] + width;
+        }
+    }
+
+    return bytecode;
+}
+
+/**
+ * Instructions that `construct_bytecode_from_postfix' takes for
+ * `postfix' without counters, or the most a std::size_t holds: tells
+ * whether it fits before any is emitted.
+ */
+inline std::size_t
+unrolled_size(Postfix const& postfix)
+{
+    constexpr auto most = std::numeric_limits<std::size_t>::max();
+    auto add = [](std::size_t a, std::size_t b) {
+        return a > most - b ? most : a + b;
+    };
+    auto times = [](std::size_t a, std::size_t b) {
+        return b and a > most / b ? most : a * b;
+    };
+
+    std::vector<std::size_t> sizes{};
+    auto pop = [&sizes]() {
+        if (sizes.empty()) {
+            throw std::runtime_error(
+              "could not construct bytecode from the stack");
+        }
+        auto size = sizes.back();
+        sizes.pop_back();
+        return size;
+    };
+    for (auto const& item : util::construct_byte_postfix(postfix)) {
+        switch (item.type) {
+            case Item::Type::T_CONCAT: {
+                auto right = pop();
+                sizes.push_back(add(pop(), right));
+                break;
+            }
+            case Item::Type::T_UNION: {
+                auto right = pop();
+                sizes.push_back(add(add(pop(), right), 1));
+                break;
+            }
+            case Item::Type::T_KLEENE_STAR:
+            case Item::Type::T_PLUS:
+            case Item::Type::T_OPTIONAL:
+                sizes.push_back(add(pop(), 1));
+                break;
+            case Item::Type::T_REPEAT: {
+                auto body = pop();
+                auto const bounds = item.bounds;
+                if (bounds.max == 0)
+                    sizes.push_back(add(body, 1));
+                else if (bounds.max == Bounds::unbounded)
+                    sizes.push_back(
+                      add(times(body, std::max(bounds.min, 1u)), 1));
+                else
+                    sizes.push_back(add(times(body, bounds.max),
+                                        bounds.max - bounds.min));
+                break;
+            }
+            case Item::Type::T_GROUP:
+                sizes.push_back(add(pop(), 2));
+                break;
+            case Item::Type::T_ASSERTION:
+            case Item::Type::T_SET:
+                sizes.push_back(1);
+                break;
+        }
+    }
+    // and the match
+    return add(sizes.empty() ? 0 : sizes.back(), 1);
+}
+
+} // namespace util
+} // namespace amat
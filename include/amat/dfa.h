@@ -0,0 +1,673 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <amat/bytecode.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * Key of a DFA state under subset construction of `amat::util::Bytecode':
+ * the sorted consuming and match instructions of an empty closure, and
+ * its assertions still waiting for the next byte with what was known of
+ * the input before them. Folding the assertions into the state keeps
+ * them free while matching.
+ */
+struct Subset
+{
+    std::vector<Instruction::Target> pcs{};
+    // context of the pending assertions, `false' without any
+    bool begin = false;
+    bool word = false;
+
+  public:
+    inline bool empty() const { return this->pcs.empty(); }
+
+    friend auto operator<=>(Subset const&, Subset const&) = default;
+};
+
+/**
+ * Instructions reached by the empty closures of one bytecode, one
+ * generation per closure: reused across closures and cleared by moving
+ * to the next generation, so that a closure costs the instructions it
+ * reaches rather than the size of the program.
+ */
+class Closure_Marks
+{
+  public:
+    Closure_Marks() = delete;
+    explicit Closure_Marks(Bytecode const& bytecode)
+      : marks_(bytecode.size(), 0)
+    {
+    }
+
+  public:
+    inline void next()
+    {
+        if (++this->generation_ == 0) {
+            std::ranges::fill(this->marks_, 0);
+            this->generation_ = 1;
+        }
+    }
+    // false when `pc' was already reached in this generation
+    inline bool mark(Instruction::Target pc)
+    {
+        if (this->marks_[pc] == this->generation_)
+            return false;
+        this->marks_[pc] = this->generation_;
+        return true;
+    }
+
+  private:
+    std::vector<std::uint32_t> marks_;
+    std::uint32_t generation_ = 0;
+};
+
+// forward declarations
+Subset
+construct_subset_from_closure(Bytecode const&,
+                              Closure_Marks&,
+                              std::span<Instruction::Target const>,
+                              Context,
+                              bool ahead = false);
+Subset
+construct_subset_from_transition(Bytecode const&,
+                                 Closure_Marks&,
+                                 Subset const&,
+                                 NFA::Input);
+
+/**
+ * Empty closure of `from' in `context'; unless `ahead', the input after
+ * it is not known yet and assertions on it are left pending.
+ */
+inline Subset
+construct_subset_from_closure(Bytecode const& bytecode,
+                              Closure_Marks& marks,
+                              std::span<Instruction::Target const> from,
+                              Context context,
+                              bool ahead)
+{
+    count(&stats::closures);
+    Subset subset{};
+    bool pending = false;
+    marks.next();
+    std::vector<Instruction::Target> stack(from.begin(), from.end());
+    while (stack.size()) {
+        auto pc = stack.back();
+        stack.pop_back();
+        if (!marks.mark(pc))
+            continue;
+        auto const& instruction = bytecode[pc];
+        switch (instruction.opcode) {
+            case Instruction::Opcode::split:
+                stack.push_back(instruction.y);
+                [[fallthrough]];
+            case Instruction::Opcode::jump:
+            case Instruction::Opcode::save:
+                stack.push_back(instruction.x);
+                break;
+            case Instruction::Opcode::assertion:
+                if (!ahead and
+                    looks_ahead(static_cast<Assertion>(instruction.y))) {
+                    subset.pcs.push_back(pc);
+                    pending = true;
+                } else if (bytecode.holds(instruction, context)) {
+                    stack.push_back(instruction.x);
+                }
+                break;
+            case Instruction::Opcode::character:
+            case Instruction::Opcode::set:
+            case Instruction::Opcode::match:
+                subset.pcs.push_back(pc);
+                break;
+            // a subset has no count, so the DFAs take unrolled bytecode
+            case Instruction::Opcode::repeat:
+            case Instruction::Opcode::increment:
+            case Instruction::Opcode::leave:
+                break;
+        }
+    }
+    std::ranges::sort(subset.pcs);
+    if (pending) {
+        subset.begin = context.begin;
+        subset.word = context.word_before;
+    }
+    return subset;
+}
+
+/**
+ * Consuming and match instructions of `subset' once the byte after it is
+ * known, or the end of the input without one: the pending assertions are
+ * checked and followed.
+ */
+inline std::vector<Instruction::Target>
+resolve_subset(Bytecode const& bytecode,
+               Closure_Marks& marks,
+               Subset const& subset,
+               std::optional<NFA::Input> next)
+{
+    std::vector<Instruction::Target> resolved{};
+    std::vector<Instruction::Target> pending{};
+    for (auto const& pc : subset.pcs) {
+        if (bytecode[pc].opcode == Instruction::Opcode::assertion)
+            pending.push_back(pc);
+        else
+            resolved.push_back(pc);
+    }
+    if (pending.empty())
+        return resolved;
+
+    Context context{ subset.begin,
+                     !next.has_value(),
+                     subset.word,
+                     next.has_value() and is_word_byte(next.value()) };
+    auto closure =
+      construct_subset_from_closure(bytecode, marks, pending, context, true);
+    resolved.insert(resolved.end(), closure.pcs.begin(), closure.pcs.end());
+    return resolved;
+}
+
+inline Subset
+construct_subset_from_transition(Bytecode const& bytecode,
+                                 Closure_Marks& marks,
+                                 Subset const& subset,
+                                 NFA::Input symbol)
+{
+    std::vector<Instruction::Target> next{};
+    for (auto const& pc : resolve_subset(bytecode, marks, subset, symbol)) {
+        auto const& instruction = bytecode[pc];
+        if (bytecode.consumes(instruction, symbol))
+            next.push_back(instruction.x);
+    }
+    if (next.empty())
+        return {};
+    return construct_subset_from_closure(
+      bytecode, marks, next, { false, false, is_word_byte(symbol), false });
+}
+
+/**
+ * True when `subset' matches before the byte `next', or at the end of the
+ * input without one.
+ */
+inline bool
+subset_accepts(Bytecode const& bytecode,
+               Closure_Marks& marks,
+               Subset const& subset,
+               std::optional<NFA::Input> next = std::nullopt)
+{
+    return std::ranges::any_of(
+      resolve_subset(bytecode, marks, subset, next), [&bytecode](auto pc) {
+          return bytecode[pc].opcode == Instruction::Opcode::match;
+      });
+}
+
+/**
+ * Start state: the closure of the first instruction at the beginning of
+ * the input, or within it after a word byte or not.
+ */
+inline Subset
+construct_start_subset(Bytecode const& bytecode,
+                       Closure_Marks& marks,
+                       bool begin = true,
+                       bool word = false)
+{
+    Instruction::Target start[] = { bytecode.start };
+    return construct_subset_from_closure(
+      bytecode, marks, start, { begin, false, word, false });
+}
+
+/**
+ * Starts of the byte ranges that no instruction tells apart, and 256:
+ * the bytes of a range always take the same transitions.
+ */
+inline std::vector<std::size_t>
+construct_byte_ranges(Bytecode const& bytecode)
+{
+    std::bitset<257> starts{};
+    starts.set(0);
+    starts.set(256);
+    auto split = [&starts](auto const& takes) {
+        for (std::size_t c = 1; c < 256; c++) {
+            if (takes(c) != takes(c - 1))
+                starts.set(c);
+        }
+    };
+    for (auto const& set : bytecode.sets) {
+        split([&set](std::size_t c) { return set[c]; });
+    }
+    for (auto const& instruction : bytecode.instructions) {
+        if (instruction.opcode == Instruction::Opcode::character) {
+            starts.set(instruction.symbol);
+            starts.set(instruction.symbol + 1u);
+        } else if (instruction.opcode == Instruction::Opcode::assertion) {
+            split([](std::size_t c) {
+                return is_word_byte(static_cast<NFA::Input>(c));
+            });
+        }
+    }
+    std::vector<std::size_t> ranges{};
+    for (std::size_t c = 0; c <= 256; c++) {
+        if (starts[c])
+            ranges.push_back(c);
+    }
+    return ranges;
+}
+
+/**
+ * DFA as a dense transition table, 256 entries per state. State 0 is the
+ * dead state: once entered, no input can lead to a match. A transition
+ * is flagged with `matched' when the input before its byte is matched,
+ * which lets a search stop at the first match.
+ */
+struct DFA
+{
+    using State = std::uint32_t;
+
+    static constexpr State dead = 0;
+    static constexpr State matched = State{ 1 } << 31;
+    static constexpr std::size_t max_states = 1024;
+
+    // state * 256 + byte
+    std::vector<State> table{};
+    std::vector<bool> accept{};
+    State start = dead;
+    // start within the input, after a non-word or a word byte
+    std::array<State, 2> within{};
+
+  public:
+    inline std::size_t size() const { return this->accept.size(); }
+
+    bool match(std::string_view str) const noexcept
+    {
+        State state = this->start;
+        for (auto const& c : str) {
+            count(&stats::bytes_scanned);
+            state = this->table[state * 256 + static_cast<NFA::Input>(c)] &
+                    ~matched;
+            if (state == dead)
+                return false;
+        }
+        return this->accept[state];
+    }
+
+    /**
+     * True once any prefix of `str' is matched, stopping at the first.
+     */
+    bool search(std::string_view str) const noexcept
+    {
+        return this->earliest(str) != Span::npos;
+    }
+
+    /**
+     * Length of the shortest prefix of `str' that is matched, i.e. where
+     * the first match of a search ends, or Span::npos.
+     */
+    std::size_t earliest(std::string_view str) const noexcept
+    {
+        State state = this->start;
+        for (std::size_t i = 0; i < str.size(); i++) {
+            count(&stats::bytes_scanned);
+            state = this->table[state * 256 + static_cast<NFA::Input>(str[i])];
+            if (state & matched)
+                return i;
+            if (state == dead)
+                return Span::npos;
+        }
+        return this->accept[state] ? str.size() : Span::npos;
+    }
+
+    /**
+     * Length of the longest match of `str' from `from', or Span::npos.
+     */
+    std::size_t longest(std::string_view str,
+                        std::size_t from = 0) const noexcept
+    {
+        State start = from == 0 ? this->start
+                                : this->within[is_word_byte(
+                                    static_cast<NFA::Input>(str[from - 1]))];
+        return this->longest_(str.begin() + from, str.end(), start);
+    }
+
+    /**
+     * Length of the longest match of the reversed input before `to', for
+     * the DFA of reversed bytecode, or Span::npos.
+     */
+    std::size_t longest_reverse(std::string_view str,
+                                std::size_t to) const noexcept
+    {
+        State start = to == str.size()
+                        ? this->start
+                        : this->within[is_word_byte(
+                            static_cast<NFA::Input>(str[to]))];
+        return this->longest_(
+          std::make_reverse_iterator(str.begin() + to), str.rend(), start);
+    }
+
+  private:
+    template<class Iterator>
+    std::size_t longest_(Iterator first,
+                         Iterator last,
+                         State state) const noexcept
+    {
+        std::size_t longest = Span::npos;
+        std::size_t length = 0;
+        for (; first != last; ++first, ++length) {
+            count(&stats::bytes_scanned);
+            state = this->table[state * 256 + static_cast<NFA::Input>(*first)];
+            if (state & matched)
+                longest = length;
+            state &= ~matched;
+            if (state == dead)
+                return longest;
+        }
+        return this->accept[state] ? length : longest;
+    }
+};
+
+/**
+ * DFA states of `bytecode' that fit in `bytes': a row of the table, and
+ * the subset of instructions of the state, kept twice while building it,
+ * taken at its largest.
+ */
+inline std::size_t
+dfa_states_within(std::size_t bytes, Bytecode const& bytecode)
+{
+    return bytes / (256 * sizeof(DFA::State) +
+                    2 * sizeof(Instruction::Target) * bytecode.size());
+}
+
+// forward declaration
+std::optional<DFA>
+construct_DFA_from_bytecode(Bytecode const&,
+                            std::size_t max_states = DFA::max_states);
+
+/**
+ * Subset construction of the whole DFA, or std::nullopt once it needs
+ * more than `max_states' states or `bytecode' has counters.
+ */
+inline std::optional<DFA>
+construct_DFA_from_bytecode(Bytecode const& bytecode, std::size_t max_states)
+{
+    if (bytecode.counters.size())
+        return std::nullopt;
+
+    DFA dfa{};
+    std::vector<Subset> subsets{ {} };
+    std::map<Subset, DFA::State> states{ { {}, DFA::dead } };
+
+    auto state_of = [&](Subset&& subset) -> DFA::State {
+        if (auto found = states.find(subset); found != states.end())
+            return found->second;
+        auto state = static_cast<DFA::State>(subsets.size());
+        states.emplace(subset, state);
+        subsets.push_back(std::move(subset));
+        return state;
+    };
+
+    auto const ranges = construct_byte_ranges(bytecode);
+    Closure_Marks marks{ bytecode };
+    dfa.start = state_of(construct_start_subset(bytecode, marks));
+    dfa.within = {
+        state_of(construct_start_subset(bytecode, marks, false, false)),
+        state_of(construct_start_subset(bytecode, marks, false, true))
+    };
+
+    for (std::size_t state = 0; state < subsets.size(); state++) {
+        if (subsets.size() > max_states)
+            return std::nullopt;
+        count(&stats::dfa_states);
+        dfa.table.resize(dfa.table.size() + 256, DFA::dead);
+        dfa.accept.push_back(subset_accepts(bytecode, marks, subsets[state]));
+        // one transition per byte range, then copied to all its bytes
+        for (std::size_t i = 0; i + 1 < ranges.size(); i++) {
+            auto symbol = static_cast<NFA::Input>(ranges[i]);
+            auto next = construct_subset_from_transition(
+              bytecode, marks, subsets[state], symbol);
+            DFA::State target = DFA::dead;
+            if (!next.empty())
+                target = state_of(std::move(next));
+            if (subset_accepts(bytecode, marks, subsets[state], symbol))
+                target |= DFA::matched;
+            std::fill(dfa.table.begin() + state * 256 + ranges[i],
+                      dfa.table.begin() + state * 256 + ranges[i + 1],
+                      target);
+        }
+    }
+
+    return dfa;
+}
+
+/**
+ * DFA built on demand while matching: a transition is computed by
+ * subset construction the first time it is taken, and the whole cache is
+ * flushed once it holds `max_states' states (at least 4: dead, start,
+ * current and next), so memory stays bounded whatever the size of the
+ * full DFA.
+ *
+ * Building a state costs about the instructions of its subset. When the
+ * input keeps the cache flushing, that work is bounded by
+ * `max_work_per_byte' instructions per byte scanned since the last flush,
+ * if not 0: past it the DFA gives up, the call returns false and
+ * `failed()' is true, so the caller can fall back on an engine linear in
+ * the program, like the Pike VM.
+ */
+class Lazy_DFA
+{
+  public:
+    using State = DFA::State;
+
+    static constexpr State unknown = ~State{ 0 };
+
+    Lazy_DFA() = delete;
+    explicit Lazy_DFA(Bytecode const& bytecode,
+                      std::size_t max_states = DFA::max_states,
+                      std::size_t max_work_per_byte = 0)
+      : bytecode_(bytecode)
+      , marks_(bytecode)
+      , max_states_(std::max<std::size_t>(max_states, 4))
+      , max_work_per_byte_(max_work_per_byte)
+    {
+        if (bytecode.counters.size()) {
+            throw std::runtime_error(
+              "could not construct a lazy DFA from bytecode with counters");
+        }
+        this->flush_();
+    }
+
+  public:
+    bool match(std::string_view str)
+    {
+        this->failed_ = false;
+        State state = this->start_;
+        for (auto const& c : str) {
+            count(&stats::bytes_scanned);
+            this->bytes_++;
+            auto symbol = static_cast<NFA::Input>(c);
+            State next = this->table_[state * 256 + symbol];
+            if (next == unknown)
+                next = this->transition_(state, symbol);
+            else
+                count(&stats::cache_hits);
+            state = next & ~DFA::matched;
+            if (state == DFA::dead)
+                return false;
+        }
+        return this->accept_[state];
+    }
+
+    /**
+     * True once any prefix of `str' is matched, stopping at the first.
+     */
+    bool search(std::string_view str)
+    {
+        return this->earliest(str) != Span::npos;
+    }
+
+    /**
+     * As `DFA::earliest'.
+     */
+    std::size_t earliest(std::string_view str)
+    {
+        this->failed_ = false;
+        State state = this->start_;
+        for (std::size_t i = 0; i < str.size(); i++) {
+            count(&stats::bytes_scanned);
+            this->bytes_++;
+            auto symbol = static_cast<NFA::Input>(str[i]);
+            State next = this->table_[state * 256 + symbol];
+            if (next == unknown)
+                next = this->transition_(state, symbol);
+            else
+                count(&stats::cache_hits);
+            if (next & DFA::matched)
+                return i;
+            state = next;
+            if (state == DFA::dead)
+                return Span::npos;
+        }
+        return this->accept_[state] ? str.size() : Span::npos;
+    }
+
+    /**
+     * As `DFA::longest'.
+     */
+    std::size_t longest(std::string_view str, std::size_t from = 0)
+    {
+        return this->longest_(
+          str.begin() + from, str.end(), from == 0, from ? str[from - 1] : 0);
+    }
+
+    /**
+     * As `DFA::longest_reverse'.
+     */
+    std::size_t longest_reverse(std::string_view str, std::size_t to)
+    {
+        return this->longest_(std::make_reverse_iterator(str.begin() + to),
+                              str.rend(),
+                              to == str.size(),
+                              to < str.size() ? str[to] : 0);
+    }
+
+    inline std::size_t size() const { return this->subsets_.size(); }
+    inline bool failed() const { return this->failed_; }
+
+  private:
+    template<class Iterator>
+    std::size_t longest_(Iterator first, Iterator last, bool begin, char before)
+    {
+        this->failed_ = false;
+        State state = begin ? this->start_
+                            : this->state_of_(construct_start_subset(
+                                this->bytecode_,
+                                this->marks_,
+                                false,
+                                is_word_byte(static_cast<NFA::Input>(before))));
+        std::size_t longest = Span::npos;
+        std::size_t length = 0;
+        for (; first != last; ++first, ++length) {
+            count(&stats::bytes_scanned);
+            this->bytes_++;
+            auto symbol = static_cast<NFA::Input>(*first);
+            State next = this->table_[state * 256 + symbol];
+            if (next == unknown)
+                next = this->transition_(state, symbol);
+            else
+                count(&stats::cache_hits);
+            if (next & DFA::matched)
+                longest = length;
+            state = next & ~DFA::matched;
+            if (state == DFA::dead)
+                return longest;
+        }
+        return this->accept_[state] ? length : longest;
+    }
+
+    void flush_()
+    {
+        this->table_.clear();
+        this->accept_.clear();
+        this->subsets_.clear();
+        this->states_.clear();
+        this->state_of_({});
+        this->start_ = this->state_of_(
+          construct_start_subset(this->bytecode_, this->marks_));
+        this->bytes_ = 0;
+        this->work_ = 0;
+    }
+
+    State state_of_(Subset&& subset)
+    {
+        if (auto found = this->states_.find(subset);
+            found != this->states_.end())
+            return found->second;
+        count(&stats::dfa_states);
+        this->work_ += subset.pcs.size();
+        auto state = static_cast<State>(this->subsets_.size());
+        this->table_.resize(this->table_.size() + 256, unknown);
+        this->accept_.push_back(
+          subset_accepts(this->bytecode_, this->marks_, subset));
+        this->states_.emplace(subset, state);
+        this->subsets_.push_back(std::move(subset));
+        return state;
+    }
+
+    /**
+     * Compute and cache a missing transition, flagged as in `DFA';
+     * `state' is renumbered when the cache is flushed to make room.
+     */
+    State transition_(State& state, NFA::Input symbol)
+    {
+        count(&stats::cache_misses);
+        auto next = construct_subset_from_transition(
+          this->bytecode_, this->marks_, this->subsets_[state], symbol);
+        if (!this->states_.contains(next) and
+            this->subsets_.size() >= this->max_states_) {
+            if (this->max_work_per_byte_ and
+                this->work_ > this->max_work_per_byte_ * this->bytes_) {
+                this->failed_ = true;
+                return DFA::dead;
+            }
+            count(&stats::cache_flushes);
+            Subset current = this->subsets_[state];
+            this->flush_();
+            state = this->state_of_(std::move(current));
+        }
+        State target = this->state_of_(std::move(next));
+        if (subset_accepts(
+              this->bytecode_, this->marks_, this->subsets_[state], symbol))
+            target |= DFA::matched;
+        this->table_[state * 256 + symbol] = target;
+        return target;
+    }
+
+  private:
+    Bytecode const& bytecode_;
+    Closure_Marks marks_;
+    std::size_t max_states_;
+    std::size_t max_work_per_byte_;
+    // since the last flush: bytes scanned and instructions of the states
+    // built
+    std::size_t bytes_ = 0;
+    std::size_t work_ = 0;
+    bool failed_ = false;
+    std::vector<State> table_{};
+    std::vector<bool> accept_{};
+    std::vector<Subset> subsets_{};
+    std::map<Subset, State> states_{};
+    State start_ = DFA::dead;
+};
+
+} // namespace util
+} // namespace amat
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <string_view>
+
+#include <amat/bytecode.h>
+#include <amat/dfa.h>
+#include <amat/nfa.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * Graphviz DOT and JSON export of the automata, written to any output
+ * iterator of `char' (e.g. `std::back_inserter' of a string or a char
+ * pointer into a large enough buffer) and returning it past the output,
+ * like `std::format_to'. Nothing is allocated: numbers are formatted on
+ * the stack and byte ranges are read straight from the tables.
+ */
+
+inline std::size_t
+memory_usage(DFA const& dfa)
+{
+    return dfa.table.size() * sizeof(DFA::State) + (dfa.size() + 7) / 8;
+}
+
+inline std::size_t
+memory_usage(Bytecode const& bytecode)
+{
+    return bytecode.size() * sizeof(Instruction) +
+           bytecode.sets.size() * sizeof(Byte_Set) +
+           bytecode.counters.size() * sizeof(Bytecode::Counter) +
+           bytecode.keys.size() * sizeof(std::size_t);
+}
+
+inline std::size_t
+memory_usage(NFA const& nfa)
+{
+    std::size_t edges = 0;
+    for (auto const& branch : nfa.edges) {
+        edges += branch.size();
+    }
+    return nfa.states.size() * sizeof(State) + edges * sizeof(Edge);
+}
+
+namespace detail {
+
+template<class Output>
+Output
+write(Output out, std::string_view str)
+{
+    for (auto const& c : str) {
+        *out++ = c;
+    }
+    return out;
+}
+
+template<class Output>
+Output
+write(Output out, std::size_t n)
+{
+    std::array<char, 24> buffer{};
+    auto end = std::to_chars(buffer.data(), buffer.data() + buffer.size(), n);
+    return write(out, std::string_view{ buffer.data(), end.ptr });
+}
+
+/**
+ * `str' inside a DOT or JSON string: quotes and backslashes escaped.
+ */
+template<class Output>
+Output
+write_escaped(Output out, std::string_view str)
+{
+    for (auto const& c : str) {
+        if (c == '"' or c == '\\')
+            *out++ = '\\';
+        *out++ = c;
+    }
+    return out;
+}
+
+/**
+ * Printable byte as itself, any other as \xHH.
+ */
+template<class Output>
+Output
+write_byte(Output out, std::size_t c)
+{
+    if (c > ' ' and c < 0x7F) {
+        char const byte[] = { static_cast<char>(c) };
+        return write_escaped(out, { byte, 1 });
+    }
+    constexpr char digits[] = "0123456789ABCDEF";
+    char const escape[] = { '\\', 'x', digits[c >> 4], digits[c & 0xF] };
+    return write_escaped(out, { escape, 4 });
+}
+
+/**
+ * Byte ranges of `takes', as DOT label text `a-z 0-9' or as JSON arrays
+ * `[97,122],[48,57]'.
+ */
+template<class Output, class Takes>
+Output
+write_ranges(Output out, Takes const& takes, bool json)
+{
+    bool first = true;
+    for (std::size_t c = 0; c < 256; c++) {
+        if (!takes(c))
+            continue;
+        std::size_t last = c;
+        while (last + 1 < 256 and takes(last + 1)) {
+            last++;
+        }
+        if (!first)
+            out = write(out, json ? "," : " ");
+        first = false;
+        if (json) {
+            out = write(write(write(out, "["), c), ",");
+            out = write(write(out, last), "]");
+        } else {
+            out = write_byte(out, c);
+            if (last != c)
+                out = write_byte(write(out, "-"), last);
+        }
+        c = last;
+    }
+    return out;
+}
+
+inline std::string_view
+opcode_as_string(Instruction::Opcode opcode)
+{
+    switch (opcode) {
+        case Instruction::Opcode::character:
+            return "character";
+        case Instruction::Opcode::set:
+            return "set";
+        case Instruction::Opcode::split:
+            return "split";
+        case Instruction::Opcode::jump:
+            return "jump";
+        case Instruction::Opcode::save:
+            return "save";
+        case Instruction::Opcode::assertion:
+            return "assertion";
+        case Instruction::Opcode::match:
+            return "match";
+        case Instruction::Opcode::repeat:
+            return "repeat";
+        case Instruction::Opcode::increment:
+            return "increment";
+        case Instruction::Opcode::leave:
+            return "leave";
+    }
+    return "unknown";
+}
+
+/**
+ * Call `edge(target, takes)' once per live target of `state', with the
+ * predicate of the bytes that lead there.
+ */
+template<class Edge_Function>
+void
+for_each_dfa_edge(DFA const& dfa, std::size_t state, Edge_Function edge)
+{
+    auto const* row = dfa.table.data() + state * 256;
+    std::array<bool, 256> done{};
+    for (std::size_t c = 0; c < 256; c++) {
+        auto target = row[c] & ~DFA::matched;
+        if (done[c] or target == DFA::dead)
+            continue;
+        auto takes = [row, target](std::size_t d) {
+            return (row[d] & ~DFA::matched) == target;
+        };
+        for (std::size_t d = c; d < 256; d++) {
+            done[d] = done[d] or takes(d);
+        }
+        edge(target, takes);
+    }
+}
+
+} // namespace detail
+
+template<class Output>
+Output
+export_dot(DFA const& dfa, Output out)
+{
+    using namespace detail;
+    out = write(write(out, "digraph dfa {\n  // states: "), dfa.size());
+    out = write(write(out, ", table entries: "), dfa.table.size());
+    out = write(write(out, ", memory: "), memory_usage(dfa));
+    out = write(out, " bytes\n  rankdir=LR;\n  start [shape=point];\n");
+    for (std::size_t state = 1; state < dfa.size(); state++) {
+        out = write(write(out, "  "), state);
+        out = write(out, dfa.accept[state] ? " [shape=doublecircle];\n"
+                                           : " [shape=circle];\n");
+    }
+    out = write(write(write(out, "  start -> "), dfa.start), ";\n");
+    for (std::size_t state = 1; state < dfa.size(); state++) {
+        for_each_dfa_edge(dfa, state, [&](auto target, auto const& takes) {
+            out = write(write(write(out, "  "), state), " -> ");
+            out = write(write(out, target), " [label=\"");
+            out = write(write_ranges(out, takes, false), "\"];\n");
+        });
+    }
+    return write(out, "}\n");
+}
+
+template<class Output>
+Output
+export_json(DFA const& dfa, Output out)
+{
+    using namespace detail;
+    out = write(write(out, "{\"type\":\"dfa\",\"states\":"), dfa.size());
+    out = write(write(out, ",\"table_entries\":"), dfa.table.size());
+    out = write(write(out, ",\"memory_bytes\":"), memory_usage(dfa));
+    out = write(write(out, ",\"start\":"), dfa.start);
+    out = write(write(out, ",\"within\":["), dfa.within[0]);
+    out = write(write(write(out, ","), dfa.within[1]), "],\"accept\":[");
+    bool first = true;
+    for (std::size_t state = 0; state < dfa.size(); state++) {
+        if (!dfa.accept[state])
+            continue;
+        out = write(write(out, first ? "" : ","), state);
+        first = false;
+    }
+    out = write(out, "],\"transitions\":[");
+    first = true;
+    for (std::size_t state = 1; state < dfa.size(); state++) {
+        for_each_dfa_edge(dfa, state, [&](auto target, auto const& takes) {
+            out = write(write(out, first ? "{\"from\":" : ",{\"from\":"), state);
+            out = write(write(out, ",\"to\":"), target);
+            out = write(write_ranges(write(out, ",\"bytes\":["), takes, true),
+                        "]}");
+            first = false;
+        });
+    }
+    return write(out, "]}\n");
+}
+
+template<class Output>
+Output
+export_dot(Bytecode const& bytecode, Output out)
+{
+    using namespace detail;
+    out = write(write(out, "digraph bytecode {\n  // instructions: "),
+                bytecode.size());
+    out = write(write(out, ", sets: "), bytecode.sets.size());
+    out = write(write(out, ", memory: "), memory_usage(bytecode));
+    out = write(out, " bytes\n  rankdir=LR;\n  start [shape=point];\n");
+    for (std::size_t pc = 0; pc < bytecode.size(); pc++) {
+        auto const& instruction = bytecode[pc];
+        out = write(write(write(out, "  "), pc), " [label=\"");
+        out = write(write(out, pc), ": ");
+        out = write(out, opcode_as_string(instruction.opcode));
+        switch (instruction.opcode) {
+            case Instruction::Opcode::character:
+                out = write_byte(write(out, " "), instruction.symbol);
+                break;
+            case Instruction::Opcode::set:
+                out = write(write(out, " ["), instruction.y);
+                out = write(out, "]");
+                break;
+            case Instruction::Opcode::save:
+                out = write(write(out, " "), instruction.y);
+                break;
+            case Instruction::Opcode::repeat:
+            case Instruction::Opcode::increment:
+            case Instruction::Opcode::leave:
+                out = write(write(out, " c"), instruction.y);
+                break;
+            case Instruction::Opcode::assertion:
+                out = write_escaped(
+                  write(out, " "),
+                  assertion_as_string(static_cast<Assertion>(instruction.y)));
+                break;
+            default:
+                break;
+        }
+        out = write(out,
+                    instruction.opcode == Instruction::Opcode::match
+                      ? "\", shape=doublecircle];\n"
+                      : "\", shape=box];\n");
+    }
+    out = write(write(write(out, "  start -> "), bytecode.start), ";\n");
+    for (std::size_t pc = 0; pc < bytecode.size(); pc++) {
+        auto const& instruction = bytecode[pc];
+        if (instruction.opcode == Instruction::Opcode::match)
+            continue;
+        out = write(write(write(out, "  "), pc), " -> ");
+        out = write(write(out, instruction.x), ";\n");
+        // the less preferred branch of a split
+        if (instruction.opcode == Instruction::Opcode::split) {
+            out = write(write(write(out, "  "), pc), " -> ");
+            out = write(write(out, instruction.y), " [style=dashed];\n");
+        }
+    }
+    return write(out, "}\n");
+}
+
+template<class Output>
+Output
+export_json(Bytecode const& bytecode, Output out)
+{
+    using namespace detail;
+    out = write(write(out, "{\"type\":\"bytecode\",\"instructions\":"),
+                bytecode.size());
+    out = write(write(out, ",\"sets\":"), bytecode.sets.size());
+    out = write(write(out, ",\"groups\":"), bytecode.groups);
+    out = write(write(out, ",\"memory_bytes\":"), memory_usage(bytecode));
+    out = write(write(out, ",\"start\":"), bytecode.start);
+    out = write(out, ",\"program\":[");
+    for (std::size_t pc = 0; pc < bytecode.size(); pc++) {
+        auto const& instruction = bytecode[pc];
+        out = write(out, pc ? ",{\"op\":\"" : "{\"op\":\"");
+        out = write(write(out, opcode_as_string(instruction.opcode)), "\"");
+        switch (instruction.opcode) {
+            case Instruction::Opcode::character:
+                out = write(write(out, ",\"byte\":"),
+                            std::size_t{ instruction.symbol });
+                break;
+            case Instruction::Opcode::set: {
+                auto const& set = bytecode.sets[instruction.y];
+                out = write(write(out, ",\"set\":"), instruction.y);
+                out = write(
+                  write_ranges(write(out, ",\"bytes\":["),
+                               [&set](std::size_t c) { return set[c]; },
+                               true),
+                  "]");
+                break;
+            }
+            case Instruction::Opcode::split:
+                out = write(write(out, ",\"y\":"), instruction.y);
+                break;
+            case Instruction::Opcode::save:
+                out = write(write(out, ",\"slot\":"), instruction.y);
+                break;
+            case Instruction::Opcode::repeat:
+            case Instruction::Opcode::increment:
+            case Instruction::Opcode::leave:
+                out = write(write(out, ",\"counter\":"), instruction.y);
+                break;
+            case Instruction::Opcode::assertion:
+                out = write(
+                  write_escaped(write(out, ",\"assertion\":\""),
+                                assertion_as_string(
+                                  static_cast<Assertion>(instruction.y))),
+                  "\"");
+                break;
+            default:
+                break;
+        }
+        if (instruction.opcode != Instruction::Opcode::match)
+            out = write(write(out, ",\"x\":"), instruction.x);
+        out = write(out, "}");
+    }
+    return write(out, "]}\n");
+}
+
+template<class Output>
+Output
+export_dot(NFA const& nfa, Output out)
+{
+    using namespace detail;
+    out = write(write(out, "digraph nfa {\n  // states: "), nfa.states.size());
+    out = write(write(out, ", memory: "), memory_usage(nfa));
+    out = write(out, " bytes\n  rankdir=LR;\n  start [shape=point];\n");
+    for (auto const& state : nfa.states) {
+        out = write(write(out, "  "), std::size_t{ state->id });
+        out = write(out, state->type == State::Type::accept
+                           ? " [shape=doublecircle];\n"
+                           : " [shape=circle];\n");
+    }
+    out = write(write(write(out, "  start -> "), std::size_t{ nfa.start->id }),
+                ";\n");
+    for (auto const& branch : nfa.edges) {
+        for (auto const& edge : branch) {
+            out = write(write(out, "  "), std::size_t{ edge.nodes.first->id });
+            out = write(write(out, " -> "), std::size_t{ edge.nodes.second->id });
+            out = write(out, " [label=\"");
+            out = edge.symbol == Epsilon ? write(out, "ε")
+                                         : write_byte(out, edge.symbol);
+            out = write(out, "\"];\n");
+        }
+    }
+    return write(out, "}\n");
+}
+
+template<class Output>
+Output
+export_json(NFA const& nfa, Output out)
+{
+    using namespace detail;
+    out = write(write(out, "{\"type\":\"nfa\",\"states\":"), nfa.states.size());
+    out = write(write(out, ",\"memory_bytes\":"), memory_usage(nfa));
+    out = write(write(out, ",\"start\":"), std::size_t{ nfa.start->id });
+    out = write(out, ",\"accept\":[");
+    bool first = true;
+    for (auto const& state : nfa.states) {
+        if (state->type != State::Type::accept)
+            continue;
+        out = write(write(out, first ? "" : ","), std::size_t{ state->id });
+        first = false;
+    }
+    out = write(out, "],\"edges\":[");
+    first = true;
+    for (auto const& branch : nfa.edges) {
+        for (auto const& edge : branch) {
+            out = write(write(out, first ? "{\"from\":" : ",{\"from\":"),
+                        std::size_t{ edge.nodes.first->id });
+            out = write(write(out, ",\"to\":"),
+                        std::size_t{ edge.nodes.second->id });
+            // 0 is the empty transition
+            out = write(write(out, ",\"symbol\":"), std::size_t{ edge.symbol });
+            out = write(out, "}");
+            first = false;
+        }
+    }
+    return write(out, "]}\n");
+}
+
+} // namespace util
+} // namespace amat
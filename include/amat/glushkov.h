@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <set>
+#include <stack>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <amat/nfa.h>
+#include <amat/parser.h>
+#include <amat/stats.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * Position (Glushkov) automaton: state 0 is the initial state and state
+ * `i > 0' is the i-th operand of the expression, entered on any byte of
+ * `symbols[i]'.
+ */
+struct Glushkov
+{
+    using Position = std::uint32_t;
+    using Positions = std::set<Position>;
+
+    std::vector<Byte_Set> symbols{ {} };
+    std::vector<Positions> follow{ {} };
+    Positions last{};
+
+  public:
+    inline std::size_t size() const { return this->symbols.size(); }
+};
+
+// forward declarations
+Glushkov
+construct_glushkov_from_regular_expression(std::string_view);
+Glushkov
+construct_glushkov_from_postfix(Postfix const&);
+
+inline Glushkov
+construct_glushkov_from_regular_expression(std::string_view source)
+{
+    Parser parser{ source };
+    return construct_glushkov_from_postfix(parser.postfix());
+}
+
+/**
+ * Build the position automaton with the classic nullable/first/last
+ * rules, evaluated on a stack in the order of the strict postfix. The
+ * positions of a sub-expression are contiguous from `Term::begin', which
+ * lets a counted repetition copy them instead of re-reading its operand.
+ */
+inline Glushkov
+construct_glushkov_from_postfix(Postfix const& postfix)
+{
+    struct Term
+    {
+        bool nullable;
+        Glushkov::Positions first;
+        Glushkov::Positions last;
+        Glushkov::Position begin;
+    };
+
+    Glushkov automaton{};
+    std::stack<Term> terms{};
+
+    auto pop = [&terms]() -> Term {
+        if (terms.empty()) {
+            throw std::runtime_error(
+              "could not construct position automaton from the stack");
+        }
+        Term term = terms.top();
+        terms.pop();
+        return term;
+    };
+    auto link = [&automaton](Glushkov::Positions const& from,
+                             Glushkov::Positions const& to) {
+        for (auto const& p : from) {
+            automaton.follow[p].insert(to.begin(), to.end());
+        }
+    };
+    auto concat = [&link](Term left, Term const& right) -> Term {
+        link(left.last, right.first);
+        if (left.nullable)
+            left.first.insert(right.first.begin(), right.first.end());
+        Glushkov::Positions last = right.last;
+        if (right.nullable)
+            last.insert(left.last.begin(), left.last.end());
+        return { left.nullable and right.nullable,
+                 std::move(left.first),
+                 std::move(last),
+                 left.begin };
+    };
+    auto optional = [](Term term) -> Term {
+        term.nullable = true;
+        return term;
+    };
+    auto plus = [&link](Term term) -> Term {
+        link(term.last, term.first);
+        return term;
+    };
+    auto copy = [&automaton](Term const& term,
+                             Glushkov::Position end) -> Term {
+        auto begin = static_cast<Glushkov::Position>(automaton.size());
+        auto offset = static_cast<Glushkov::Position>(begin - term.begin);
+        auto shift = [offset](Glushkov::Positions const& positions) {
+            Glushkov::Positions shifted{};
+            for (auto const& p : positions) {
+                shifted.emplace(static_cast<Glushkov::Position>(p + offset));
+            }
+            return shifted;
+        };
+        for (auto p = term.begin; p < end; p++) {
+            automaton.symbols.push_back(automaton.symbols[p]);
+            automaton.follow.push_back(shift(automaton.follow[p]));
+        }
+        return {
+            term.nullable, shift(term.first), shift(term.last), begin
+        };
+    };
+    auto repeat = [&](Term const& term, Bounds bounds) -> Term {
+        if (bounds.max == 0)
+            return { true, {}, {}, term.begin };
+        auto count = bounds.max == Bounds::unbounded
+                       ? std::max(bounds.min, 1u)
+                       : bounds.max;
+        auto end = static_cast<Glushkov::Position>(automaton.size());
+        std::vector<Term> copies{ term };
+        for (unsigned i = 1; i < count; i++) {
+            copies.push_back(copy(term, end));
+        }
+        if (bounds.max == Bounds::unbounded) {
+            copies.back() = bounds.min ? plus(copies.back())
+                                       : optional(plus(copies.back()));
+            bounds.min = count;
+        }
+        std::optional<Term> tail{};
+        for (auto i = count; i > bounds.min; i--) {
+            tail = optional(tail ? concat(copies[i - 1], tail.value())
+                                 : copies[i - 1]);
+        }
+        for (auto i = bounds.min; i > 0; i--) {
+            tail = tail ? concat(copies[i - 1], tail.value()) : copies[i - 1];
+        }
+        tail->begin = term.begin;
+        return tail.value();
+    };
+
+    for (auto const& item : util::construct_byte_postfix(postfix)) {
+        switch (item.type) {
+            case Item::Type::T_CONCAT: {
+                Term right = pop();
+                Term left = pop();
+                terms.push(concat(std::move(left), right));
+                break;
+            }
+            case Item::Type::T_UNION: {
+                Term right = pop();
+                Term left = pop();
+                left.first.insert(right.first.begin(), right.first.end());
+                left.last.insert(right.last.begin(), right.last.end());
+                left.nullable = left.nullable or right.nullable;
+                terms.push(std::move(left));
+                break;
+            }
+            case Item::Type::T_GROUP:
+                break;
+            case Item::Type::T_ASSERTION:
+                throw std::runtime_error(
+                  "could not construct position automaton: assertions are "
+                  "not supported");
+            case Item::Type::T_KLEENE_STAR:
+                terms.push(optional(plus(pop())));
+                break;
+            case Item::Type::T_PLUS:
+                terms.push(plus(pop()));
+                break;
+            case Item::Type::T_OPTIONAL:
+                terms.push(optional(pop()));
+                break;
+            case Item::Type::T_REPEAT:
+                terms.push(repeat(pop(), item.bounds));
+                break;
+            case Item::Type::T_SET: {
+                auto position =
+                  static_cast<Glushkov::Position>(automaton.size());
+                automaton.symbols.push_back(item.set);
+                automaton.follow.push_back({});
+                terms.push({ false, { position }, { position }, position });
+                break;
+            }
+        }
+    }
+
+    if (terms.empty()) {
+        automaton.last = { 0 };
+        return automaton;
+    }
+    Term term = pop();
+    if (!terms.empty()) {
+        throw std::runtime_error("could not construct position automaton: "
+                                 "unbalanced expression");
+    }
+    automaton.follow[0] = term.first;
+    automaton.last = term.last;
+    if (term.nullable)
+        automaton.last.emplace(0);
+
+    return automaton;
+}
+
+/**
+ * Bit-parallel simulation of a position automaton of at most 64 states,
+ * in the Shift-And family. Every state is one bit of a machine word: the
+ * follow edges `i -> i + 1' are taken by a single shift, the remaining
+ * edges by one table lookup per active byte of the word, and the input
+ * byte then masks out the states it cannot enter.
+ */
+class Bit_Parallel
+{
+  public:
+    using Mask = std::uint64_t;
+    static constexpr std::size_t max_states = 64;
+
+    Bit_Parallel() = delete;
+    explicit Bit_Parallel(Glushkov const& automaton)
+    {
+        if (automaton.size() > max_states) {
+            throw std::runtime_error(
+              "position automaton too large for bit-parallel simulation");
+        }
+        for (std::size_t p = 1; p < automaton.size(); p++) {
+            for (std::size_t c = 0; c < 256; c++) {
+                if (automaton.symbols[p][c])
+                    this->masks_[c] |= Mask{ 1 } << p;
+            }
+        }
+        for (auto const& p : automaton.last) {
+            this->accept_ |= Mask{ 1 } << p;
+        }
+
+        std::array<Mask, max_states> irregular{};
+        for (std::size_t p = 0; p < automaton.size(); p++) {
+            for (auto const& q : automaton.follow[p]) {
+                if (q == p + 1)
+                    this->shift_ |= Mask{ 1 } << p;
+                else
+                    irregular[p] |= Mask{ 1 } << q;
+            }
+        }
+
+        for (std::size_t chunk = 0; chunk < this->follow_.size(); chunk++) {
+            bool active = false;
+            for (std::size_t byte = 0; byte < 256; byte++) {
+                Mask next = 0;
+                for (std::size_t bit = 0; bit < 8; bit++) {
+                    if (byte & (1u << bit))
+                        next |= irregular[chunk * 8 + bit];
+                }
+                this->follow_[chunk][byte] = next;
+                active = active or next != 0;
+            }
+            if (active)
+                this->chunks_ = chunk + 1;
+        }
+    }
+
+  public:
+    bool match(std::string_view str) const noexcept
+    {
+        Mask states = 1;
+        for (auto const& c : str) {
+            count(&stats::bytes_scanned);
+            states =
+              this->follow(states) & this->masks_[static_cast<NFA::Input>(c)];
+            count_step(static_cast<std::size_t>(std::popcount(states)));
+            if (!states)
+                return false;
+        }
+        return states & this->accept_;
+    }
+
+    /**
+     * True once any prefix of `str' is matched, stopping at the first.
+     */
+    bool search(std::string_view str) const noexcept
+    {
+        return this->earliest(str) != Span::npos;
+    }
+
+    /**
+     * As `DFA::earliest'.
+     */
+    std::size_t earliest(std::string_view str) const noexcept
+    {
+        Mask states = 1;
+        if (states & this->accept_)
+            return 0;
+        for (std::size_t i = 0; i < str.size(); i++) {
+            count(&stats::bytes_scanned);
+            states = this->follow(states) &
+                     this->masks_[static_cast<NFA::Input>(str[i])];
+            count_step(static_cast<std::size_t>(std::popcount(states)));
+            if (states & this->accept_)
+                return i + 1;
+            if (!states)
+                return Span::npos;
+        }
+        return Span::npos;
+    }
+
+    inline Mask follow(Mask states) const noexcept
+    {
+        Mask next = (states & this->shift_) << 1;
+        for (std::size_t chunk = 0; chunk < this->chunks_; chunk++) {
+            next |= this->follow_[chunk][(states >> (chunk * 8)) & 0xff];
+        }
+        return next;
+    }
+
+  private:
+    std::array<Mask, 256> masks_{};
+    std::array<std::array<Mask, 256>, max_states / 8> follow_{};
+    std::size_t chunks_ = 0;
+    Mask shift_ = 0;
+    Mask accept_ = 0;
+};
+
+} // namespace util
+} // namespace amat
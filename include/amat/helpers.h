@@ -2,14 +2,38 @@
 
 #include <iomanip>
 #include <iostream>
+#include <set>
+#include <string>
 #include <string_view>
 
-#include <amat/nfa.h>
+#include <amat/amat.h>
+
+/**
+ * Debug printing of the legacy NFA to `std::cout'. Opt-in: <amat/amat.h>
+ * does not include it, so only the translation units that print pay for
+ * <iostream>. For tooling, see <amat/export.h>.
+ */
 
 namespace amat {
+
+inline std::ostream&
+operator<<(std::ostream& os, State::Type type)
+{
+    switch (type) {
+        case State::Type::initial:
+            return os << 0;
+        case State::Type::normal:
+            return os << 1;
+        case State::Type::accept:
+            return os << 2;
+        default:
+            return os << -1;
+    }
+}
+
 namespace util {
 
-std::string
+inline std::string
 to_state_symbol(char k)
 {
     if (k == 0)
@@ -18,7 +42,7 @@ to_state_symbol(char k)
         return std::string{ k };
 }
 
-void
+inline void
 print_branch(NFA::Branch const& branch)
 {
     for (auto const& edge : branch) {
@@ -30,49 +54,59 @@ print_branch(NFA::Branch const& branch)
         }
     }
 }
-void
+
+inline void
 print_states(NFA const& nfa)
 {
-    std::cout << "States: " << std::endl;
+    std::cout << "States:\n";
     for (auto const& state : nfa.states) {
         std::cout << "State: " << state.get()->id << " " << state.get()->type
-                  << std::endl;
+                  << "\n";
     }
 }
 
-void
+inline void
 print_states(std::set<Edge::Node> const& states)
 {
-    std::cout << "States: " << std::endl;
+    std::cout << "States:\n";
     for (auto const& state : states) {
         std::cout << "State: " << state.get()->id << " " << state.get()->type
-                  << std::endl;
+                  << "\n";
     }
 }
 
-void
+inline void
 print_edges(NFA::Edges const& edges)
 {
     for (auto const& branch : edges) {
-        std::cout << "  Edges count: " << branch.size() << std::endl;
+        std::cout << "  Edges count: " << branch.size() << "\n";
         print_branch(branch);
-        std::cout << std::endl;
+        std::cout << "\n";
     }
 }
 
-void
+inline void
 print_NFA(NFA const& nfa, std::string_view expr)
 {
-    auto edges = nfa.edges;
-    std::cout << "Regular Expression: " << std::quoted(expr) << std::endl;
-    std::cout << "<<NFA>>" << std::endl;
-    std::cout << "States: " << nfa.states.size() << std::endl;
-    std::cout << "Initial state: " << nfa.start.get()->id << std::endl;
+    std::cout << "Regular Expression: " << std::quoted(expr) << "\n";
+    std::cout << "<<NFA>>\n";
+    std::cout << "States: " << nfa.states.size() << "\n";
+    std::cout << "Initial state: " << nfa.start.get()->id << "\n";
     std::cout << "Final state: "
-              << nfa.edges.back().back().nodes.second.get()->id << std::endl;
-    std::cout << "Branches: " << nfa.edges.size() << std::endl;
-    print_edges(edges);
+              << nfa.edges.back().back().nodes.second.get()->id << "\n";
+    std::cout << "Branches: " << nfa.edges.size() << "\n";
+    print_edges(nfa.edges);
 }
 
 } // namespace util
-} // namespace amat
\ No newline at end of file
+
+template<literals::Regular_Expression_String RegExp>
+void
+print()
+{
+    constexpr auto content = RegExp.r;
+    util::print_NFA(util::construct_NFA_from_regular_expression(content),
+                    content);
+}
+
+} // namespace amat
@@ -1,13 +1,83 @@
 #pragma once
 
+#include <bitset>
 #include <cctype>
 #include <optional>
+#include <stdexcept>
 #include <string_view>
 
 #include <amat/tokens.h>
+#include <amat/utf8.h>
 
 namespace amat {
 
+/**
+ * Set of input bytes taken by a single transition.
+ */
+using Byte_Set = std::bitset<256>;
+
+/**
+ * ASCII bytes, the part of a class that is matched as single bytes. Built
+ * where it is used rather than held in a global, whose initialization
+ * every translation unit would run at startup.
+ */
+inline Byte_Set
+ascii() noexcept
+{
+    Byte_Set const low{ ~0ull };
+    return low | low << 64;
+}
+
+/**
+ * Bounds of a counted repetition `{min,max}'.
+ */
+struct Bounds
+{
+    static constexpr unsigned unbounded = ~0u;
+    static constexpr unsigned limit = 1000;
+
+    unsigned min = 0;
+    unsigned max = unbounded;
+};
+
+/**
+ * Options of a pattern, given when it is compiled.
+ */
+enum class Flags : unsigned
+{
+    none = 0,
+    // fold case into the automaton, for ASCII, Latin-1, Greek and
+    // Cyrillic letters
+    icase = 1 << 0
+};
+
+inline constexpr Flags icase = Flags::icase;
+
+constexpr Flags
+operator|(Flags left, Flags right)
+{
+    return static_cast<Flags>(static_cast<unsigned>(left) |
+                              static_cast<unsigned>(right));
+}
+
+constexpr bool
+has_flag(Flags flags, Flags flag)
+{
+    return static_cast<unsigned>(flags) & static_cast<unsigned>(flag);
+}
+
+/**
+ * Zero-width assertion on the input around the current offset: `^', `$',
+ * `\b' and `\B'.
+ */
+enum class Assertion : unsigned char
+{
+    begin_text,
+    end_text,
+    word_boundary,
+    not_word_boundary
+};
+
 class Lexer
 {
   public:
@@ -24,8 +94,6 @@ class Lexer
     Token get_next_token()
     {
         Token token = Token::T_UNKNOWN;
-        unsigned char read =
-          static_cast<unsigned char>(this->source_[this->pointer_]);
 
         this->last_ = this->current_;
 
@@ -34,6 +102,11 @@ class Lexer
             return Token::T_END;
         }
 
+        unsigned char read =
+          static_cast<unsigned char>(this->source_[this->pointer_]);
+
+        this->pointer_++;
+
         switch (read) {
             case '*':
                 token = Token::T_KLEENE_STAR;
@@ -47,18 +120,77 @@ class Lexer
             case ')':
                 token = Token::T_CLOSE_PAREN;
                 break;
+            case '+':
+                token = Token::T_PLUS;
+                break;
+            case '?':
+                token = Token::T_OPTIONAL;
+                break;
+            case '{':
+                token = this->scan_bounds_() ? Token::T_REPEAT : Token::T_CHAR;
+                break;
+            case '^':
+                token = Token::T_ASSERTION;
+                this->assertion_ = Assertion::begin_text;
+                break;
+            case '$':
+                token = Token::T_ASSERTION;
+                this->assertion_ = Assertion::end_text;
+                break;
+            case '.':
+                token = Token::T_SET;
+                this->set_ = ascii();
+                this->set_.reset('\n');
+                this->codes_.clear();
+                this->codes_.negate(0x80);
+                break;
+            case '[':
+                token = Token::T_SET;
+                this->scan_class_();
+                break;
+            case '\\':
+                if (this->pointer_ < this->source_.length() and
+                    (this->source_[this->pointer_] == 'b' or
+                     this->source_[this->pointer_] == 'B')) {
+                    token = Token::T_ASSERTION;
+                    this->assertion_ = this->source_[this->pointer_++] == 'b'
+                                         ? Assertion::word_boundary
+                                         : Assertion::not_word_boundary;
+                    break;
+                }
+                this->set_.reset();
+                this->codes_.clear();
+                if (auto escaped =
+                      this->scan_escape_(this->set_, this->codes_)) {
+                    token = this->code_(escaped.value());
+                    read = static_cast<unsigned char>(escaped.value());
+                } else {
+                    token = Token::T_SET;
+                }
+                break;
+            default:
+                token = Token::T_CHAR;
+                // a UTF-8 sequence is one codepoint, any other byte is
+                // matched as it is
+                if (read >= 0x80) {
+                    if (auto decoded = util::decode_utf8(
+                          this->source_.substr(this->pointer_ - 1))) {
+                        this->pointer_ += decoded->second - 1;
+                        token = this->code_(decoded->first);
+                    }
+                }
+                break;
         }
 
-        if (std::isalpha(read))
-            token = Token::T_CHAR;
-
-        this->pointer_++;
-
         this->current_ = token;
         this->scanner_ = read;
         return token;
     }
     inline std::optional<unsigned char> scanner() const { return scanner_; }
+    inline Byte_Set const& set() const { return set_; }
+    inline Code_Set const& codes() const { return codes_; }
+    inline Bounds const& bounds() const { return bounds_; }
+    inline Assertion assertion() const { return assertion_; }
     inline unsigned int pointer() { return pointer_; }
 
   public:
@@ -69,10 +201,261 @@ class Lexer
     }
     inline Token operator*() const { return current_; }
 
+  private:
+    /**
+     * Token of a single codepoint: a byte below U+0080, else a set of
+     * the codepoint alone.
+     */
+    Token code_(char32_t code)
+    {
+        if (code < 0x80)
+            return Token::T_CHAR;
+        this->set_.reset();
+        this->codes_.clear();
+        this->codes_.insert(code, code);
+        return Token::T_SET;
+    }
+
+    /**
+     * Read `m}', `m,}' or `m,n}' after a `{'; otherwise leave the input as
+     * it is, and the `{' is a literal.
+     */
+    bool scan_bounds_()
+    {
+        auto pointer = this->pointer_;
+        auto number = [this]() -> std::optional<unsigned> {
+            std::optional<unsigned> value{};
+            while (this->pointer_ < this->source_.length() and
+                   std::isdigit(static_cast<unsigned char>(
+                     this->source_[this->pointer_]))) {
+                value = value.value_or(0) * 10 +
+                        (this->source_[this->pointer_++] - '0');
+                if (value.value() > Bounds::limit)
+                    throw std::runtime_error(
+                      "parse error: repetition bound too large");
+            }
+            return value;
+        };
+        auto next_is = [this](char c) {
+            if (this->pointer_ < this->source_.length() and
+                this->source_[this->pointer_] == c) {
+                this->pointer_++;
+                return true;
+            }
+            return false;
+        };
+
+        auto min = number();
+        if (min.has_value()) {
+            this->bounds_ = { min.value(), min.value() };
+            if (next_is(','))
+                this->bounds_.max = number().value_or(Bounds::unbounded);
+            if (next_is('}')) {
+                if (this->bounds_.max < this->bounds_.min)
+                    throw std::runtime_error(
+                      "parse error: invalid repetition bounds");
+                return true;
+            }
+        }
+        this->pointer_ = pointer;
+        return false;
+    }
+
+    /**
+     * Read `n' hexadecimal digits, or as many as there are up to `n'
+     * when `at_most'.
+     */
+    char32_t scan_hex_(std::size_t n, bool at_most = false)
+    {
+        char32_t value = 0;
+        std::size_t i = 0;
+        for (; i < n; i++) {
+            if (this->pointer_ >= this->source_.length() or
+                !std::isxdigit(
+                  static_cast<unsigned char>(this->source_[this->pointer_])))
+                break;
+            auto digit =
+              static_cast<unsigned char>(this->source_[this->pointer_++]);
+            value = value * 16 + (std::isdigit(digit)
+                                    ? digit - '0'
+                                    : std::tolower(digit) - 'a' + 10);
+        }
+        if (i == 0 or (i < n and !at_most))
+            throw std::runtime_error(
+              "parse error: invalid hexadecimal escape");
+        return value;
+    }
+
+    /**
+     * Read the byte after a backslash: a class escape (\d, \w, \s and
+     * their negations) is added to `set' and `codes', anything else is
+     * returned as a codepoint: \xHH and \uHHHH or \u{H...} by value, and
+     * any other escaped byte as itself.
+     */
+    std::optional<char32_t> scan_escape_(Byte_Set& set, Code_Set& codes)
+    {
+        if (this->pointer_ >= this->source_.length())
+            throw std::runtime_error("parse error: trailing backslash");
+
+        unsigned char read =
+          static_cast<unsigned char>(this->source_[this->pointer_++]);
+        Byte_Set escaped{};
+        switch (read) {
+            case 'n':
+                return '\n';
+            case 't':
+                return '\t';
+            case 'r':
+                return '\r';
+            case 'f':
+                return '\f';
+            case 'v':
+                return '\v';
+            case 'x':
+                return this->scan_hex_(2);
+            case 'u': {
+                char32_t code = 0;
+                if (this->pointer_ < this->source_.length() and
+                    this->source_[this->pointer_] == '{') {
+                    this->pointer_++;
+                    code = this->scan_hex_(6, true);
+                    if (this->pointer_ >= this->source_.length() or
+                        this->source_[this->pointer_++] != '}')
+                        throw std::runtime_error(
+                          "parse error: invalid unicode escape");
+                } else {
+                    code = this->scan_hex_(4);
+                }
+                if (code > Code_Set::max or
+                    (code >= Code_Set::surrogates.first and
+                     code <= Code_Set::surrogates.second))
+                    throw std::runtime_error(
+                      "parse error: invalid unicode escape");
+                return code;
+            }
+            case 'd':
+            case 'D':
+            case 'w':
+            case 'W':
+            case 's':
+            case 'S':
+                for (unsigned c = 0; c < 128; c++) {
+                    switch (std::tolower(read)) {
+                        case 'd':
+                            escaped[c] = std::isdigit(c);
+                            break;
+                        case 'w':
+                            escaped[c] = std::isalnum(c) or c == '_';
+                            break;
+                        default:
+                            escaped[c] = std::isspace(c);
+                            break;
+                    }
+                }
+                if (std::isupper(read)) {
+                    escaped = ~escaped & ascii();
+                    codes.insert(0x80, Code_Set::max);
+                }
+                set |= escaped;
+                return std::nullopt;
+        }
+        return read;
+    }
+
+    /**
+     * Read a bracket expression after its `[': codepoints, ranges `a-z'
+     * and escapes, negated by a leading `^'; a leading `]' is a literal.
+     * A byte that does not begin a UTF-8 sequence is a member as it is.
+     */
+    void scan_class_()
+    {
+        this->set_.reset();
+        this->codes_.clear();
+        bool negated = false;
+        bool first = true;
+        if (this->pointer_ < this->source_.length() and
+            this->source_[this->pointer_] == '^') {
+            negated = true;
+            this->pointer_++;
+        }
+
+        struct Member
+        {
+            char32_t code;
+            // a class escape, already added
+            bool is_set;
+            // a byte that is not UTF-8
+            bool is_byte;
+        };
+        auto next_member = [this]() -> Member {
+            auto read =
+              static_cast<unsigned char>(this->source_[this->pointer_]);
+            if (read == '\\') {
+                this->pointer_++;
+                if (auto escaped = this->scan_escape_(this->set_, this->codes_))
+                    return { escaped.value(), false, false };
+                return { 0, true, false };
+            }
+            if (auto decoded =
+                  util::decode_utf8(this->source_.substr(this->pointer_))) {
+                this->pointer_ += decoded->second;
+                return { decoded->first, false, false };
+            }
+            this->pointer_++;
+            return { read, false, true };
+        };
+        auto insert = [this](char32_t low, char32_t high) {
+            for (auto c = low; c <= std::min<char32_t>(high, 0x7F); c++) {
+                this->set_.set(c);
+            }
+            if (high >= 0x80)
+                this->codes_.insert(std::max<char32_t>(low, 0x80), high);
+        };
+
+        while (true) {
+            if (this->pointer_ >= this->source_.length())
+                throw std::runtime_error(
+                  "parse error: unterminated character class");
+            if (this->source_[this->pointer_] == ']' and !first) {
+                this->pointer_++;
+                break;
+            }
+            first = false;
+
+            Member low = next_member();
+            if (low.is_set)
+                continue;
+            if (this->pointer_ + 1 < this->source_.length() and
+                this->source_[this->pointer_] == '-' and
+                this->source_[this->pointer_ + 1] != ']') {
+                this->pointer_++;
+                Member high = next_member();
+                if (low.is_byte or high.is_set or high.is_byte or
+                    high.code < low.code)
+                    throw std::runtime_error(
+                      "parse error: invalid character class range");
+                insert(low.code, high.code);
+            } else if (low.is_byte) {
+                this->set_.set(low.code);
+            } else {
+                insert(low.code, low.code);
+            }
+        }
+
+        if (negated) {
+            this->set_ = ~this->set_ & ascii();
+            this->codes_.negate(0x80);
+        }
+    }
+
   private:
     std::string_view source_;
     unsigned int pointer_;
     std::optional<unsigned char> scanner_;
+    Byte_Set set_{};
+    Code_Set codes_{};
+    Bounds bounds_{};
+    Assertion assertion_ = Assertion::begin_text;
     Token current_;
     Token last_;
 };
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <amat/bytecode.h>
+#include <amat/stats.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * Patterns made of single bytes, concatenations and unions only, e.g.
+ * `GET|POST', matched as the finite set of strings they denote: a single
+ * literal by `memchr' and `memcmp', a set by an Aho-Corasick automaton
+ * whose failure links are folded into a dense table over the classes of
+ * the bytes that occur in a literal. At the root, bytes that start no
+ * literal are skipped without stepping the automaton.
+ */
+struct Literal_Set
+{
+    using State = std::uint32_t;
+
+    // bytes of all the literals, i.e. states of the automaton
+    static constexpr std::size_t max_states = std::size_t{ 1 } << 16;
+
+    // sorted, without duplicates
+    std::vector<std::string> literals{};
+    // class of each byte, 0 for the bytes of no literal
+    std::array<std::uint16_t, 256> classes{};
+    std::size_t width = 1;
+    // state * width + class; state 0 is the root
+    std::vector<State> table{};
+    // length of the path from the root to each state, and of the longest
+    // literal that ends there, if any
+    std::vector<std::uint32_t> depth{};
+    std::vector<std::uint32_t> longest{};
+    // bytes that start a literal, and the only one when there is one
+    std::array<bool, 256> first{};
+    std::size_t firsts = 0;
+    unsigned char first_byte = 0;
+    std::size_t max_length = 0;
+
+  public:
+    /**
+     * True if `str' is one of the literals.
+     */
+    bool match(std::string_view str) const noexcept
+    {
+        count(&stats::bytes_scanned, str.size());
+        if (this->literals.size() == 1)
+            return str == this->literals.front();
+        return std::ranges::binary_search(this->literals, str);
+    }
+
+    /**
+     * True if any literal occurs in `str'.
+     */
+    bool search(std::string_view str) const noexcept
+    {
+        if (this->literals.size() == 1)
+            return str.find(this->literals.front()) != std::string_view::npos;
+        State state = 0;
+        for (std::size_t i = 0; i < str.size(); i++) {
+            if (state == 0 and (i = this->skip_(str, i)) == str.size())
+                break;
+            count(&stats::bytes_scanned);
+            state = this->step_(state, str[i]);
+            if (this->longest[state])
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     * Span of the leftmost-longest literal in `str': the automaton gives
+     * the leftmost start once no literal can start before it, then the
+     * longest literal from there is read along the trie. With
+     * `Policy::earliest', the longest of the literals that end first.
+     */
+    std::optional<Span>
+    find(std::string_view str,
+         Policy policy = Policy::leftmost_longest) const noexcept
+    {
+        if (this->literals.size() == 1) {
+            auto begin = str.find(this->literals.front());
+            if (begin == std::string_view::npos)
+                return std::nullopt;
+            return Span{ begin, begin + this->max_length };
+        }
+        if (policy == Policy::earliest)
+            return this->earliest_(str);
+        std::size_t begin = Span::npos;
+        State state = 0;
+        for (std::size_t i = 0; i < str.size(); i++) {
+            if (state == 0 and (i = this->skip_(str, i)) == str.size())
+                break;
+            if (begin != Span::npos and i >= begin + this->max_length)
+                break;
+            count(&stats::bytes_scanned);
+            state = this->step_(state, str[i]);
+            if (this->longest[state])
+                begin = std::min(begin, i + 1 - this->longest[state]);
+        }
+        if (begin == Span::npos)
+            return std::nullopt;
+
+        std::size_t length = 0;
+        state = 0;
+        for (std::size_t i = begin; i < str.size(); i++) {
+            state = this->step_(state, str[i]);
+            if (this->depth[state] != i - begin + 1)
+                break;
+            if (this->longest[state] == this->depth[state])
+                length = this->depth[state];
+        }
+        return Span{ begin, begin + length };
+    }
+
+  private:
+    std::optional<Span> earliest_(std::string_view str) const noexcept
+    {
+        State state = 0;
+        for (std::size_t i = 0; i < str.size(); i++) {
+            if (state == 0 and (i = this->skip_(str, i)) == str.size())
+                break;
+            count(&stats::bytes_scanned);
+            state = this->step_(state, str[i]);
+            if (this->longest[state])
+                return Span{ i + 1 - this->longest[state], i + 1 };
+        }
+        return std::nullopt;
+    }
+
+    inline State step_(State state, char c) const noexcept
+    {
+        return this->table[state * this->width +
+                           this->classes[static_cast<unsigned char>(c)]];
+    }
+
+    /**
+     * Offset of the first byte from `i' that starts a literal.
+     */
+    std::size_t skip_(std::string_view str, std::size_t i) const noexcept
+    {
+        std::size_t next = str.size();
+        if (this->firsts == 1) {
+            auto const* found =
+              std::memchr(str.data() + i, this->first_byte, str.size() - i);
+            if (found)
+                next = static_cast<char const*>(found) - str.data();
+        } else {
+            next = i;
+            while (next < str.size() and
+                   !this->first[static_cast<unsigned char>(str[next])])
+                next++;
+        }
+        count(&stats::prefilter_skips, next - i);
+        return next;
+    }
+};
+
+// forward declaration
+std::optional<Literal_Set>
+construct_literal_set_from_postfix(Postfix const&);
+
+/**
+ * Build the literal set of `postfix', or std::nullopt when it takes
+ * anything else than single bytes, concatenations, unions, optionals and
+ * groups, matches the empty string, or its literals hold more than
+ * `Literal_Set::max_states' bytes.
+ */
+inline std::optional<Literal_Set>
+construct_literal_set_from_postfix(Postfix const& postfix)
+{
+    using Strings = std::vector<std::string>;
+    auto bytes = [](Strings const& strings) {
+        std::size_t size = 0;
+        for (auto const& string : strings)
+            size += string.size();
+        return size;
+    };
+
+    std::vector<Strings> operands{};
+    for (auto const& item : construct_byte_postfix(postfix)) {
+        switch (item.type) {
+            case Item::Type::T_SET: {
+                if (item.set.count() != 1)
+                    return std::nullopt;
+                std::size_t byte = 0;
+                while (!item.set.test(byte))
+                    byte++;
+                operands.push_back({ std::string(1, static_cast<char>(byte)) });
+                break;
+            }
+            case Item::Type::T_CONCAT: {
+                Strings right = std::move(operands.back());
+                operands.pop_back();
+                Strings& left = operands.back();
+                if (left.size() * bytes(right) + right.size() * bytes(left) >
+                    Literal_Set::max_states)
+                    return std::nullopt;
+                Strings product{};
+                product.reserve(left.size() * right.size());
+                for (auto const& prefix : left) {
+                    for (auto const& suffix : right)
+                        product.push_back(prefix + suffix);
+                }
+                left = std::move(product);
+                break;
+            }
+            case Item::Type::T_UNION: {
+                Strings right = std::move(operands.back());
+                operands.pop_back();
+                Strings& left = operands.back();
+                if (bytes(left) + bytes(right) > Literal_Set::max_states)
+                    return std::nullopt;
+                left.insert(left.end(),
+                            std::make_move_iterator(right.begin()),
+                            std::make_move_iterator(right.end()));
+                break;
+            }
+            case Item::Type::T_OPTIONAL:
+                // as left by `util::simplify', e.g. `ab|a' -> `ab?'
+                operands.back().emplace_back();
+                break;
+            case Item::Type::T_GROUP:
+                break;
+            default:
+                return std::nullopt;
+        }
+    }
+    auto empty = [](std::string const& literal) { return literal.empty(); };
+    if (operands.size() != 1 or std::ranges::any_of(operands.back(), empty))
+        return std::nullopt;
+
+    Literal_Set set{};
+    set.literals = std::move(operands.back());
+    std::ranges::sort(set.literals);
+    auto duplicates = std::ranges::unique(set.literals);
+    set.literals.erase(duplicates.begin(), duplicates.end());
+
+    for (auto const& literal : set.literals) {
+        set.max_length = std::max(set.max_length, literal.size());
+        auto const head = static_cast<unsigned char>(literal.front());
+        if (!set.first[head]) {
+            set.first[head] = true;
+            set.first_byte = head;
+            set.firsts++;
+        }
+        for (auto c : literal) {
+            auto& byte_class = set.classes[static_cast<unsigned char>(c)];
+            if (!byte_class)
+                byte_class = static_cast<std::uint16_t>(set.width++);
+        }
+    }
+
+    // the trie, with missing transitions unset
+    constexpr auto unset = ~Literal_Set::State{ 0 };
+    auto add_state = [&set, unset](std::uint32_t depth) {
+        set.table.resize(set.table.size() + set.width, unset);
+        set.depth.push_back(depth);
+        set.longest.push_back(0);
+        return static_cast<Literal_Set::State>(set.depth.size() - 1);
+    };
+    add_state(0);
+    for (auto const& literal : set.literals) {
+        Literal_Set::State state = 0;
+        for (auto c : literal) {
+            auto const edge = state * set.width +
+                              set.classes[static_cast<unsigned char>(c)];
+            if (set.table[edge] == unset) {
+                auto const next = add_state(set.depth[state] + 1);
+                set.table[edge] = next;
+            }
+            state = set.table[edge];
+        }
+        set.longest[state] = set.depth[state];
+    }
+
+    // failure links in breadth-first order, each folded into the missing
+    // transitions of its state
+    std::vector<Literal_Set::State> failure(set.depth.size(), 0);
+    std::vector<Literal_Set::State> queue{};
+    for (std::size_t c = 0; c < set.width; c++) {
+        auto& next = set.table[c];
+        if (next == unset)
+            next = 0;
+        else
+            queue.push_back(next);
+    }
+    for (std::size_t i = 0; i < queue.size(); i++) {
+        auto const state = queue[i];
+        for (std::size_t c = 0; c < set.width; c++) {
+            auto& next = set.table[state * set.width + c];
+            auto const fallback = set.table[failure[state] * set.width + c];
+            if (next == unset) {
+                next = fallback;
+                continue;
+            }
+            failure[next] = fallback;
+            if (!set.longest[next])
+                set.longest[next] = set.longest[fallback];
+            queue.push_back(next);
+        }
+    }
+    return set;
+}
+
+} // namespace util
+} // namespace amat
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace amat {
+
+/**
+ * Read-only, shared memory mapping of a whole file, e.g. a blob of
+ * `amat::serialize' for `amat::dfa_view'. Pages are loaded on first use
+ * and shared by every process mapping the same file. POSIX only, so it
+ * is not included by <amat/amat.h>.
+ */
+class mapped_file
+{
+  public:
+    mapped_file() = delete;
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+    explicit mapped_file(std::string const& path)
+    {
+        int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (descriptor < 0)
+            throw std::runtime_error("mapped_file: could not open " + path);
+        struct stat status
+        {};
+        if (::fstat(descriptor, &status) < 0 or status.st_size == 0) {
+            ::close(descriptor);
+            throw std::runtime_error("mapped_file: could not read " + path);
+        }
+        this->size_ = static_cast<std::size_t>(status.st_size);
+        this->data_ =
+          ::mmap(nullptr, this->size_, PROT_READ, MAP_SHARED, descriptor, 0);
+        ::close(descriptor);
+        if (this->data_ == MAP_FAILED)
+            throw std::runtime_error("mapped_file: could not map " + path);
+    }
+    ~mapped_file() { ::munmap(this->data_, this->size_); }
+
+  public:
+    inline std::span<std::byte const> bytes() const
+    {
+        return { static_cast<std::byte const*>(this->data_), this->size_ };
+    }
+
+  private:
+    void* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace amat
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <optional>
@@ -12,8 +13,6 @@
 #include <utility>
 #include <vector>
 
-#include <amat/helpers.h>
-#include <amat/nfa.h>
 #include <amat/parser.h>
 
 namespace amat {
@@ -23,23 +22,8 @@ struct NFA;
 using Automata = std::stack<NFA>;
 
 namespace util {
-using Alphabet = std::set<unsigned char>;
 
-Alphabet const alphabet = {
-    'A', 'B', 'C', 'D', 'E', 'F', 'G',  'H', 'I', 'J', 'K',    'L', 'M',
-    'N', 'O', 'P', 'Q', 'R', 'S', 'T',  'U', 'V', 'W', 'X',    'Y', 'Z',
-    'a', 'b', 'c', 'd', 'e', 'f', 'g',  'h', 'i', 'j', 'k',    'l', 'm',
-    'n', 'o', 'p', 'q', 'r', 's', 't',  'u', 'v', 'w', 'x',    'y', 'z',
-
-    '0', '1', '2', '3', '4', '5', '6',  '7', '8', '9', '\x20', '}', '~',
-
-    '!', '"', '#', '$', '%', '&', '\'', '(', ')', '*', '+',    ',', '-',
-    '.', '/', ':', ';', '<', '=', '>',  '?', '@', '[', '\\',   ']', '^',
-    '_', '`', '{', '|',
-
-};
-
-unsigned char const Epsilon = 0;
+inline constexpr unsigned char Epsilon = 0;
 
 } // namespace util
 
@@ -55,21 +39,11 @@ struct State
         normal
     };
 
-    friend constexpr std::ostream& operator<<(std::ostream& os, Type type)
-    {
-        switch (type) {
-            case State::Type::initial:
-                return os << 0;
-            case State::Type::normal:
-                return os << 1;
-            case State::Type::accept:
-                return os << 2;
-            default:
-                return os << -1;
-        }
-    }
+    // wide enough that ids never wrap: a pattern would run out of memory
+    // long before 2^32 states
+    using Id = std::uint32_t;
 
-    explicit State(unsigned short id_, Type type_)
+    explicit State(Id id_, Type type_)
       : id(id_)
       , type(type_)
     {
@@ -92,7 +66,7 @@ struct State
         return state1.id < state2.id;
     }
 
-    unsigned short id;
+    Id id;
     Type type;
 };
 
@@ -214,7 +188,7 @@ namespace util {
 // forward declarations
 NFA construct_NFA_from_regular_expression(std::string_view);
 NFA
-construct_NFA_from_character(unsigned char, unsigned short);
+construct_NFA_from_character(unsigned char, State::Id);
 NFA
 construct_NFA_from_concatenation(Automata&);
 NFA
@@ -222,7 +196,7 @@ construct_NFA_from_kleene_star(Automata&);
 NFA
 construct_NFA_from_union(Automata&);
 
-NFA
+inline NFA
 construct_NFA_from_regular_expression(std::string_view source)
 {
     Parser parser{ source };
@@ -243,7 +217,7 @@ construct_NFA_from_regular_expression(std::string_view source)
                 automata.push(construct_NFA_from_concatenation(automata));
                 break;
             default:
-                unsigned short last_id = 0;
+                State::Id last_id = 0;
                 if (automata.size()) {
                     last_id = automata.top()
                                 .edges.back()
@@ -262,16 +236,16 @@ construct_NFA_from_regular_expression(std::string_view source)
     return nfa;
 }
 
-namespace {
+namespace detail {
 
 // forward declaration
 void
-reevaluate_each_state_id_on_branch(NFA::Branch& branch, unsigned short* start);
+reevaluate_each_state_id_on_branch(NFA::Branch& branch, State::Id* start);
 
-void
+inline void
 prepend_start_transition_each_branch(NFA& nfa,
                                      Edge::Node const& state,
-                                     unsigned short* start_id)
+                                     State::Id* start_id)
 {
     auto i = 0;
     std::ranges::for_each(
@@ -287,7 +261,7 @@ prepend_start_transition_each_branch(NFA& nfa,
       });
 }
 
-void
+inline void
 append_end_transition_each_branch(NFA& nfa, Edge::Node const& state)
 {
     nfa.accepted.emplace(state);
@@ -300,8 +274,8 @@ append_end_transition_each_branch(NFA& nfa, Edge::Node const& state)
     });
 }
 
-void
-reevaluate_each_state_id_on_branch(NFA::Branch& branch, unsigned short* start)
+inline void
+reevaluate_each_state_id_on_branch(NFA::Branch& branch, State::Id* start)
 {
     std::ranges::for_each(
       std::next(branch.begin()), branch.end(), [&start, &branch](Edge& edge) {
@@ -319,7 +293,7 @@ reevaluate_each_state_id_on_branch(NFA::Branch& branch, unsigned short* start)
       });
 }
 
-void
+inline void
 connect_kleene_edge_on_single_branch(Automata& automata,
                                      Edge::Node& start_state,
                                      Edge& cyclic_forward_edge,
@@ -343,7 +317,7 @@ connect_kleene_edge_on_single_branch(Automata& automata,
     forward.splice(forward.begin(), back);
 }
 
-void
+inline void
 connect_kleene_edge_multiple_branches(NFA& nfa,
                                       Edge& cyclic_forward_edge,
                                       Edge& cyclic_edge,
@@ -358,25 +332,24 @@ connect_kleene_edge_multiple_branches(NFA& nfa,
     forward.splice(forward.begin(), back);
 }
 
-} // namespace
+} // namespace detail
 
-NFA
-construct_NFA_from_character(unsigned char c, unsigned short start)
+inline NFA
+construct_NFA_from_character(unsigned char c, State::Id start)
 {
     Edge::Node start_state =
       std::make_shared<State>(State{ start, State::Type::initial });
     Edge::Node end_state =
       std::make_shared<State>(State{ ++start, State::Type::accept });
     NFA nfa{ start_state };
-    if (!alphabet.contains(c)) {
-        std::cerr << "Invalid character: \"" << c << "\"" << std::endl;
+    if (c == Epsilon) {
         throw std::runtime_error("operator not defined in alphabet");
     }
     nfa.connect_edge(c, end_state, 0);
     return nfa;
 }
 
-NFA
+inline NFA
 construct_NFA_from_concatenation(Automata& automata)
 {
     if (automata.size() < 2) {
@@ -390,7 +363,7 @@ construct_NFA_from_concatenation(Automata& automata)
     return arg1;
 }
 
-NFA
+inline NFA
 construct_NFA_from_kleene_star(Automata& automata)
 {
     Edge::Node start_state =
@@ -437,7 +410,7 @@ construct_NFA_from_kleene_star(Automata& automata)
 
           if (arg2.has_value()) {
               if (arg2->edges.back().size() == 1)
-                  connect_kleene_edge_on_single_branch(
+                  detail::connect_kleene_edge_on_single_branch(
                     automata,
                     start_state,
                     cyclic_forward_edge,
@@ -445,7 +418,7 @@ construct_NFA_from_kleene_star(Automata& automata)
                     arg2.value().edges.back(),
                     branch);
               else
-                  connect_kleene_edge_multiple_branches(
+                  detail::connect_kleene_edge_multiple_branches(
                     arg,
                     cyclic_forward_edge,
                     cyclic_edge,
@@ -459,14 +432,14 @@ construct_NFA_from_kleene_star(Automata& automata)
     end_state.get()->id = arg.edges.back().back().nodes.first.get()->id + 2;
 
     if (automata.empty())
-        append_end_transition_each_branch(arg, end_state);
+        detail::append_end_transition_each_branch(arg, end_state);
 
     nfa.connect_NFA(arg);
 
     return nfa;
 }
 
-NFA
+inline NFA
 construct_NFA_from_union(Automata& automata)
 {
     Edge::Node start_state =
@@ -485,12 +458,12 @@ construct_NFA_from_union(Automata& automata)
 
     std::array<NFA*, 2> root_branches = { &arg2, &arg1 };
 
-    unsigned short id = start_state.get()->id + 2;
+    State::Id id = start_state.get()->id + 2;
 
     std::ranges::for_each(root_branches.begin(),
                           root_branches.end(),
                           [&id, &start_state](NFA*& arg) {
-                              prepend_start_transition_each_branch(
+                              detail::prepend_start_transition_each_branch(
                                 *arg, start_state, &id);
                               id++;
                           });
@@ -500,7 +473,7 @@ construct_NFA_from_union(Automata& automata)
     std::ranges::for_each(
       root_branches.begin(), root_branches.end(), [&id, &end_state](NFA*& arg) {
           id++;
-          append_end_transition_each_branch(*arg, end_state);
+          detail::append_end_transition_each_branch(*arg, end_state);
       });
 
     nfa.connect_NFA(arg2);
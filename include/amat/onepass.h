@@ -0,0 +1,184 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <amat/bytecode.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * One-pass DFA: for bytecode where at most one thread can consume any
+ * given byte, each DFA state is a single thread, and the capture slots
+ * written on the way to the next byte are stored in the transition.
+ */
+struct One_Pass
+{
+    using Node = std::uint32_t;
+    // bitmask of the slots set to the current offset
+    using Actions = std::uint32_t;
+
+    static constexpr Node dead = ~Node{ 0 };
+    static constexpr std::size_t max_nodes = dead;
+    static constexpr std::size_t max_slots = 32;
+
+    struct Transition
+    {
+        Node next = dead;
+        Actions actions = 0;
+    };
+
+    // node * 256 + byte
+    std::vector<Transition> table{};
+    // not `dead' for nodes that can match at the end of the input
+    std::vector<Transition> accept{};
+    std::size_t slots = 0;
+
+  public:
+    inline std::size_t size() const { return this->accept.size(); }
+
+    bool match(std::string_view str, std::span<Span> groups) const noexcept
+    {
+        std::array<std::size_t, max_slots> offsets{};
+        offsets.fill(Span::npos);
+        auto apply = [&offsets, this](Actions actions, std::size_t offset) {
+            for (std::size_t slot = 0; actions; slot++, actions >>= 1) {
+                if (actions & 1)
+                    offsets[slot] = offset;
+            }
+        };
+
+        Node node = 0;
+        for (std::size_t offset = 0; offset < str.size(); offset++) {
+            count(&stats::bytes_scanned);
+            auto const& transition =
+              this->table[node * 256 + static_cast<NFA::Input>(str[offset])];
+            if (transition.next == dead)
+                return false;
+            apply(transition.actions, offset);
+            node = transition.next;
+        }
+        if (this->accept[node].next == dead)
+            return false;
+        apply(this->accept[node].actions, str.size());
+
+        for (std::size_t i = 0; i < groups.size(); i++) {
+            groups[i] = { offsets[i * 2], offsets[i * 2 + 1] };
+        }
+        return true;
+    }
+};
+
+/**
+ * Nodes of a one-pass DFA that fit in `bytes': a row of the table and
+ * its accepting transition.
+ */
+constexpr std::size_t
+one_pass_nodes_within(std::size_t bytes)
+{
+    return bytes / (257 * sizeof(One_Pass::Transition));
+}
+
+// forward declarations
+std::optional<One_Pass>
+construct_one_pass_from_bytecode(Bytecode const&,
+                                 std::size_t max_nodes = One_Pass::max_nodes);
+
+/**
+ * Build the one-pass DFA of `bytecode', or std::nullopt when it is not
+ * one-pass: two threads may consume the same byte, reach the same
+ * instruction along different empty paths, or there are too many slots
+ * or more than `max_nodes' nodes. Assertions and counted loops are left
+ * to the other engines.
+ */
+inline std::optional<One_Pass>
+construct_one_pass_from_bytecode(Bytecode const& bytecode,
+                                 std::size_t max_nodes)
+{
+    using Target = Instruction::Target;
+
+    if (bytecode.slots() > One_Pass::max_slots)
+        return std::nullopt;
+
+    One_Pass dfa{};
+    dfa.slots = bytecode.slots();
+
+    if (max_nodes == 0)
+        return std::nullopt;
+    std::vector<Target> nodes{ bytecode.start };
+    std::vector<One_Pass::Node> node_of(bytecode.size(), One_Pass::dead);
+    node_of[bytecode.start] = 0;
+
+    std::vector<bool> visited(bytecode.size(), false);
+    std::vector<std::pair<Target, One_Pass::Actions>> stack{};
+
+    for (std::size_t node = 0; node < nodes.size(); node++) {
+        dfa.table.resize(dfa.table.size() + 256);
+        dfa.accept.push_back({});
+        visited.assign(bytecode.size(), false);
+        stack.push_back({ nodes[node], 0 });
+
+        while (stack.size()) {
+            auto [pc, actions] = stack.back();
+            stack.pop_back();
+            if (visited[pc])
+                return std::nullopt;
+            visited[pc] = true;
+
+            auto const& instruction = bytecode[pc];
+            switch (instruction.opcode) {
+                case Instruction::Opcode::jump:
+                    stack.push_back({ instruction.x, actions });
+                    break;
+                case Instruction::Opcode::split:
+                    stack.push_back({ instruction.y, actions });
+                    stack.push_back({ instruction.x, actions });
+                    break;
+                case Instruction::Opcode::save:
+                    stack.push_back(
+                      { instruction.x,
+                        actions | One_Pass::Actions{ 1 } << instruction.y });
+                    break;
+                case Instruction::Opcode::assertion:
+                case Instruction::Opcode::repeat:
+                case Instruction::Opcode::increment:
+                case Instruction::Opcode::leave:
+                    return std::nullopt;
+                case Instruction::Opcode::match:
+                    dfa.accept[node] = { 0, actions };
+                    break;
+                case Instruction::Opcode::character:
+                case Instruction::Opcode::set: {
+                    if (node_of[instruction.x] == One_Pass::dead) {
+                        if (nodes.size() >= max_nodes)
+                            return std::nullopt;
+                        node_of[instruction.x] =
+                          static_cast<One_Pass::Node>(nodes.size());
+                        nodes.push_back(instruction.x);
+                    }
+                    for (std::size_t c = 0; c < 256; c++) {
+                        if (!bytecode.consumes(instruction,
+                                               static_cast<NFA::Input>(c)))
+                            continue;
+                        auto& transition = dfa.table[node * 256 + c];
+                        if (transition.next != One_Pass::dead)
+                            return std::nullopt;
+                        transition = { node_of[instruction.x], actions };
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+    return dfa;
+}
+
+} // namespace util
+} // namespace amat
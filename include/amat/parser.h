@@ -1,17 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <amat/lexer.h>
 #include <amat/parser.h>
 #include <amat/tokens.h>
+#include <amat/utf8.h>
 
 namespace amat {
 
 /* Order of precedence: Highest to lowest - Associativity
   1) Parenthesis    - non-associative
-  2) Kleene star    - left
+  2) Kleene star, plus, optional and counted repetition - left
   3) Concatenation  - left
   4) Union          - left
 */
@@ -20,6 +24,9 @@ enum class Operator : unsigned
     T_OPEN_PAREN = 4,
     T_CLOSE_PAREN = 4,
     T_KLEENE_STAR = 3,
+    T_PLUS = 3,
+    T_OPTIONAL = 3,
+    T_REPEAT = 3,
     T_CONCAT = 2,
     T_UNION = 1,
     T_UNKNOWN = 0
@@ -35,6 +42,12 @@ get_order_from_operator_char(unsigned char c)
             return Operator::T_CLOSE_PAREN;
         case '*':
             return Operator::T_KLEENE_STAR;
+        case '+':
+            return Operator::T_PLUS;
+        case '?':
+            return Operator::T_OPTIONAL;
+        case '{':
+            return Operator::T_REPEAT;
         case '.':
             return Operator::T_CONCAT;
         case '|':
@@ -43,14 +56,255 @@ get_order_from_operator_char(unsigned char c)
     return Operator::T_UNKNOWN;
 }
 
+/**
+ * Number of capture groups, i.e. parenthesized sub-expressions.
+ */
+constexpr std::size_t
+count_capture_groups(std::string_view source)
+{
+    std::size_t groups = 0;
+    for (std::size_t i = 0; i < source.length(); i++) {
+        switch (source[i]) {
+            case '\\':
+                i++;
+                break;
+            case '[':
+                // a leading `^' and `]' belong to the bracket expression
+                if (i + 1 < source.length() and source[i + 1] == '^')
+                    i++;
+                if (i + 1 < source.length() and source[i + 1] == ']')
+                    i++;
+                while (++i < source.length() and source[i] != ']') {
+                    if (source[i] == '\\')
+                        i++;
+                }
+                break;
+            case '(':
+                groups++;
+                break;
+        }
+    }
+    return groups;
+}
+
+/**
+ * Element of the strict postfix form of an expression: an operand that
+ * takes any byte of `set', or an operator on the items before it. A
+ * counted repetition keeps its `bounds' instead of copies of its operand.
+ */
+struct Item
+{
+    enum class Type : unsigned char
+    {
+        T_SET,
+        T_CONCAT,
+        T_UNION,
+        T_KLEENE_STAR,
+        T_PLUS,
+        T_OPTIONAL,
+        T_REPEAT,
+        T_GROUP,
+        T_ASSERTION
+    };
+
+    Type type;
+    Byte_Set set{};
+    Bounds bounds{};
+    Assertion assertion = Assertion::begin_text;
+    // codepoints from U+0080 taken besides the bytes of `set', as UTF-8
+    Code_Set codes{};
+};
+
+using Postfix = std::vector<Item>;
+
+constexpr Item::Type
+repetition_item_type(Token token)
+{
+    switch (token) {
+        case Token::T_PLUS:
+            return Item::Type::T_PLUS;
+        case Token::T_OPTIONAL:
+            return Item::Type::T_OPTIONAL;
+        case Token::T_REPEAT:
+            return Item::Type::T_REPEAT;
+        default:
+            return Item::Type::T_KLEENE_STAR;
+    }
+}
+
+constexpr char const*
+assertion_as_string(Assertion assertion)
+{
+    switch (assertion) {
+        case Assertion::begin_text:
+            return "^";
+        case Assertion::end_text:
+            return "$";
+        case Assertion::word_boundary:
+            return "\\b";
+        case Assertion::not_word_boundary:
+            return "\\B";
+    }
+    return "";
+}
+
+/**
+ * Render a postfix expression with the operator characters of
+ * `Parser::parse()', a single byte or codepoint as itself, any other set
+ * as `[n]' with its size n, and an assertion as it is written.
+ */
+inline std::string
+postfix_as_string(Postfix const& postfix)
+{
+    std::string output{};
+    for (auto const& item : postfix) {
+        switch (item.type) {
+            case Item::Type::T_SET:
+                if (item.set.count() == 1 and item.codes.empty()) {
+                    for (std::size_t c = 0; c < 256; c++) {
+                        if (item.set[c])
+                            output.push_back(static_cast<char>(c));
+                    }
+                } else if (item.set.none() and item.codes.count() == 1) {
+                    std::array<unsigned char, 4> bytes{};
+                    auto length =
+                      util::encode_utf8(item.codes.ranges[0].first, bytes);
+                    output.append(bytes.begin(), bytes.begin() + length);
+                } else {
+                    output += "[" +
+                              std::to_string(item.set.count() +
+                                             item.codes.count()) +
+                              "]";
+                }
+                break;
+            case Item::Type::T_CONCAT:
+                output.push_back('.');
+                break;
+            case Item::Type::T_UNION:
+                output.push_back('|');
+                break;
+            case Item::Type::T_KLEENE_STAR:
+                output.push_back('*');
+                break;
+            case Item::Type::T_PLUS:
+                output.push_back('+');
+                break;
+            case Item::Type::T_OPTIONAL:
+                output.push_back('?');
+                break;
+            case Item::Type::T_REPEAT:
+                output += "{" + std::to_string(item.bounds.min) + ",";
+                if (item.bounds.max != Bounds::unbounded)
+                    output += std::to_string(item.bounds.max);
+                output.push_back('}');
+                break;
+            case Item::Type::T_GROUP:
+                output.push_back(')');
+                break;
+            case Item::Type::T_ASSERTION:
+                output += assertion_as_string(item.assertion);
+                break;
+        }
+    }
+    return output;
+}
+
+namespace util {
+
+/**
+ * Add the other case of each letter of a set: uppercase ranges and the
+ * offset to their lowercase letters.
+ */
+inline void
+fold_case(Byte_Set& set, Code_Set& codes)
+{
+    static constexpr std::pair<Code_Set::Range, char32_t> cases[] = {
+        { { 'A', 'Z' }, 0x20 },        { { 0xC0, 0xD6 }, 0x20 },
+        { { 0xD8, 0xDE }, 0x20 },      { { 0x391, 0x3A1 }, 0x20 },
+        { { 0x3A3, 0x3A9 }, 0x20 },    { { 0x400, 0x40F }, 0x50 },
+        { { 0x410, 0x42F }, 0x20 },
+    };
+
+    Code_Set members = codes;
+    for (char32_t c = 0; c < 0x80; c++) {
+        if (set[c])
+            members.insert(c, c);
+    }
+    auto add = [&set, &codes](char32_t low, char32_t high) {
+        for (auto c = low; c <= std::min<char32_t>(high, 0x7F); c++) {
+            set.set(c);
+        }
+        if (high >= 0x80)
+            codes.insert(std::max<char32_t>(low, 0x80), high);
+    };
+    for (auto const& [member_low, member_high] : members.ranges) {
+        for (auto const& [upper, offset] : cases) {
+            auto low = std::max(member_low, upper.first);
+            auto high = std::min(member_high, upper.second);
+            if (low <= high)
+                add(low + offset, high + offset);
+            low = std::max<char32_t>(member_low, upper.first + offset);
+            high = std::min<char32_t>(member_high, upper.second + offset);
+            if (low <= high)
+                add(low - offset, high - offset);
+        }
+    }
+}
+
+/**
+ * Rewrite every set with codepoints as the union of its bytes and of
+ * its UTF-8 sequences, so the automata take one byte per transition.
+ */
+inline Postfix
+construct_byte_postfix(Postfix const& postfix)
+{
+    Postfix output{};
+    output.reserve(postfix.size());
+    for (auto const& item : postfix) {
+        if (item.type != Item::Type::T_SET or item.codes.empty()) {
+            output.push_back(item);
+            continue;
+        }
+        std::size_t alternatives = 0;
+        auto alternative = [&output, &alternatives]() {
+            if (alternatives++)
+                output.push_back({ Item::Type::T_UNION });
+        };
+        if (item.set.any()) {
+            output.push_back({ Item::Type::T_SET, item.set });
+            alternative();
+        }
+        for (auto const& [low, high] : item.codes.ranges) {
+            for (auto const& sequence : construct_utf8_sequences(low, high)) {
+                for (std::size_t i = 0; i < sequence.size(); i++) {
+                    Byte_Set bytes{};
+                    for (unsigned c = sequence[i].first;
+                         c <= sequence[i].second;
+                         c++) {
+                        bytes.set(c);
+                    }
+                    output.push_back({ Item::Type::T_SET, bytes });
+                    if (i)
+                        output.push_back({ Item::Type::T_CONCAT });
+                }
+                alternative();
+            }
+        }
+    }
+    return output;
+}
+
+} // namespace util
+
 class Parser
 {
   public:
     // using enum Operators;
     Parser(Parser const&) = default;
-    explicit Parser(std::string_view str)
+    explicit Parser(std::string_view str, Flags flags = Flags::none)
       : source_(str)
       , lexer_(str)
+      , flags_(flags)
     {
     }
 
@@ -93,6 +347,122 @@ class Parser
         return this->output_;
     }
 
+    /**
+     * Strict postfix form of the expression: unary operators directly
+     * follow their operand and groups take part in concatenation, e.g.
+     * "a*bb" -> "a*b.b.", and a group is closed by its own item, so
+     * "(ab)*" -> "ab.)*". `parse()' keeps the layout consumed by
+     * `util::construct_NFA_from_regular_expression'. With `Flags::icase'
+     * each set also takes the other case of its letters.
+     */
+    Postfix postfix() const
+    {
+        Lexer lexer{ this->source_ };
+        Postfix output{};
+        std::string operators{};
+        bool operand = false;
+
+        auto push_output = [&output](unsigned char op) {
+            output.push_back({ op == '.' ? Item::Type::T_CONCAT
+                                         : Item::Type::T_UNION });
+        };
+        auto push_operator = [&push_output, &operators](unsigned char op) {
+            while (operators.length() and operators.back() != '(' and
+                   get_order_from_operator_char(operators.back()) >=
+                     get_order_from_operator_char(op)) {
+                push_output(operators.back());
+                operators.pop_back();
+            }
+            operators.push_back(op);
+        };
+
+        while (*lexer++ != amat::Token::T_END) {
+            switch (*lexer) {
+                case Token::T_CHAR:
+                case Token::T_SET:
+                    if (operand)
+                        push_operator('.');
+                    output.push_back({ Item::Type::T_SET, lexer.set() });
+                    if (*lexer == Token::T_CHAR) {
+                        output.back().set.reset();
+                        output.back().set.set(lexer.scanner().value());
+                    } else {
+                        output.back().codes = lexer.codes();
+                    }
+                    if (has_flag(this->flags_, Flags::icase))
+                        util::fold_case(output.back().set,
+                                        output.back().codes);
+                    operand = true;
+                    break;
+                case Token::T_ASSERTION:
+                    if (operand)
+                        push_operator('.');
+                    output.push_back({ Item::Type::T_ASSERTION,
+                                       {},
+                                       {},
+                                       lexer.assertion() });
+                    operand = true;
+                    break;
+                case Token::T_OPEN_PAREN:
+                    if (operand)
+                        push_operator('.');
+                    operators.push_back('(');
+                    operand = false;
+                    break;
+                case Token::T_CLOSE_PAREN:
+                    if (!operand)
+                        throw std::runtime_error("parse error: empty group");
+                    while (operators.length() and operators.back() != '(') {
+                        push_output(operators.back());
+                        operators.pop_back();
+                    }
+                    if (!operators.length()) {
+                        throw std::runtime_error(
+                          "parse error: unclosed parenthesis pair");
+                    }
+                    operators.pop_back();
+                    output.push_back({ Item::Type::T_GROUP });
+                    break;
+                case Token::T_KLEENE_STAR:
+                case Token::T_PLUS:
+                case Token::T_OPTIONAL:
+                case Token::T_REPEAT:
+                    if (!operand)
+                        throw std::runtime_error(
+                          "parse error: nothing to repeat");
+                    output.push_back(
+                      { repetition_item_type(*lexer),
+                        {},
+                        *lexer == Token::T_REPEAT ? lexer.bounds()
+                                                  : Bounds{} });
+                    break;
+                case Token::T_UNION:
+                    if (!operand)
+                        throw std::runtime_error(
+                          "parse error: empty alternative");
+                    push_operator('|');
+                    operand = false;
+                    break;
+
+                default:
+                    throw std::runtime_error("parse error: invalid operator");
+            }
+        }
+        if (!operand and !this->source_.empty()) {
+            throw std::runtime_error("parse error: empty alternative");
+        }
+
+        while (operators.length()) {
+            if (operators.back() == '(') {
+                throw std::runtime_error(
+                  "parse error: unclosed parenthesis pair");
+            }
+            push_output(operators.back());
+            operators.pop_back();
+        }
+        return output;
+    }
+
   private:
     void parse_kleene_star_()
     {
@@ -158,6 +528,7 @@ class Parser
   private:
     std::string_view source_;
     Lexer lexer_;
+    Flags flags_;
     bool is_concat_ = false;
     std::string output_{};
     std::string operators_{};
@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <amat/bytecode.h>
+
+namespace amat {
+namespace util {
+
+/**
+ * Pike VM: runs every thread of `amat::util::Bytecode' in lockstep over
+ * the input, one program counter and one set of capture slots per
+ * thread. A thread reaching an instruction already taken by a thread of
+ * higher priority is dropped, so each byte costs at most one visit per
+ * instruction and the match is linear in the input. In a counted loop,
+ * threads are told apart by their count as well: a visit per key, see
+ * `Bytecode::key', whose count `amat::limits::max_threads' bounds.
+ */
+class Pike_VM
+{
+  public:
+    using Target = Instruction::Target;
+
+    Pike_VM() = delete;
+    explicit Pike_VM(Bytecode const& bytecode)
+      : bytecode_(bytecode)
+      , current_(bytecode)
+      , next_(bytecode)
+      , scratch_(bytecode.slots(), Span::npos)
+    {
+    }
+
+  public:
+    bool match(std::string_view str, std::span<Span> groups)
+    {
+        auto const slots = this->bytecode_.slots();
+        bool found = false;
+
+        this->current_.clear();
+        std::ranges::fill(this->scratch_, Span::npos);
+        this->add_thread_(
+          this->current_, this->bytecode_.start, 0, Context::at(str, 0), 0);
+
+        for (std::size_t offset = 0; offset <= str.size(); offset++) {
+            if (!this->current_.size())
+                break;
+            count_step(this->current_.size());
+            if (offset < str.size())
+                count(&stats::bytes_scanned);
+            this->next_.clear();
+            for (std::size_t i = 0; i < this->current_.size(); i++) {
+                auto const& thread = this->current_.dense[i];
+                auto const& instruction = this->bytecode_[thread.pc];
+                auto const* saved = this->current_.slots_of(i);
+                if (instruction.opcode == Instruction::Opcode::match) {
+                    if (offset == str.size()) {
+                        this->matched_.assign(saved, saved + slots);
+                        found = true;
+                        break;
+                    }
+                } else if (offset < str.size() and
+                           this->bytecode_.consumes(
+                             instruction,
+                             static_cast<NFA::Input>(str[offset]))) {
+                    std::copy(saved, saved + slots, this->scratch_.begin());
+                    this->add_thread_(this->next_,
+                                      instruction.x,
+                                      thread.count,
+                                      Context::at(str, offset + 1),
+                                      offset + 1);
+                }
+            }
+            std::swap(this->current_, this->next_);
+        }
+
+        if (!found)
+            return false;
+        for (std::size_t i = 0; i < groups.size(); i++) {
+            groups[i] = { this->matched_[i * 2], this->matched_[i * 2 + 1] };
+        }
+        return true;
+    }
+
+    /**
+     * True as soon as a thread reaches `match', at any offset: run on an
+     * unanchored program, it tells whether the pattern occurs in `str'.
+     */
+    bool search(std::string_view str)
+    {
+        return this->earliest(str) != Span::npos;
+    }
+
+    /**
+     * Offset where the first thread reaches `match', or Span::npos.
+     */
+    std::size_t earliest(std::string_view str)
+    {
+        this->current_.clear();
+        this->add_thread_(
+          this->current_, this->bytecode_.start, 0, Context::at(str, 0), 0);
+
+        for (std::size_t offset = 0; offset <= str.size(); offset++) {
+            if (!this->current_.size())
+                break;
+            count_step(this->current_.size());
+            if (offset < str.size())
+                count(&stats::bytes_scanned);
+            this->next_.clear();
+            for (std::size_t i = 0; i < this->current_.size(); i++) {
+                auto const& thread = this->current_.dense[i];
+                auto const& instruction = this->bytecode_[thread.pc];
+                if (instruction.opcode == Instruction::Opcode::match)
+                    return offset;
+                if (offset < str.size() and
+                    this->bytecode_.consumes(
+                      instruction, static_cast<NFA::Input>(str[offset]))) {
+                    this->add_thread_(this->next_,
+                                      instruction.x,
+                                      thread.count,
+                                      Context::at(str, offset + 1),
+                                      offset + 1);
+                }
+            }
+            std::swap(this->current_, this->next_);
+        }
+        return Span::npos;
+    }
+
+    /**
+     * As `DFA::longest', for a search whose lazy DFA gave up: every
+     * thread runs to the end, as the longest match ignores priorities.
+     */
+    std::size_t longest(std::string_view str, std::size_t from = 0)
+    {
+        return this->longest_(
+          str.size() - from,
+          [&](std::size_t length) { return Context::at(str, from + length); },
+          [&](std::size_t length) { return str[from + length]; });
+    }
+
+    /**
+     * As `DFA::longest_reverse', reading back from `to' with reversed
+     * bytecode, in which the context of each offset is mirrored.
+     */
+    std::size_t longest_reverse(std::string_view str, std::size_t to)
+    {
+        return this->longest_(
+          to,
+          [&](std::size_t length) {
+              auto const context = Context::at(str, to - length);
+              return Context{ context.end,
+                              context.begin,
+                              context.word_after,
+                              context.word_before };
+          },
+          [&](std::size_t length) { return str[to - length - 1]; });
+    }
+
+  private:
+    template<class Context_At, class Byte_At>
+    std::size_t
+    longest_(std::size_t size, Context_At context_at, Byte_At byte_at)
+    {
+        std::size_t longest = Span::npos;
+        this->current_.clear();
+        this->add_thread_(
+          this->current_, this->bytecode_.start, 0, context_at(0), 0);
+
+        for (std::size_t length = 0; length <= size; length++) {
+            if (!this->current_.size())
+                break;
+            count_step(this->current_.size());
+            if (length < size)
+                count(&stats::bytes_scanned);
+            this->next_.clear();
+            for (std::size_t i = 0; i < this->current_.size(); i++) {
+                auto const& thread = this->current_.dense[i];
+                auto const& instruction = this->bytecode_[thread.pc];
+                if (instruction.opcode == Instruction::Opcode::match)
+                    longest = length;
+                else if (length < size and
+                         this->bytecode_.consumes(
+                           instruction,
+                           static_cast<NFA::Input>(byte_at(length)))) {
+                    this->add_thread_(this->next_,
+                                      instruction.x,
+                                      thread.count,
+                                      context_at(length + 1),
+                                      length + 1);
+                }
+            }
+            std::swap(this->current_, this->next_);
+        }
+        return longest;
+    }
+
+    struct Thread
+    {
+        Target pc;
+        Target count;
+        std::size_t key;
+    };
+
+    /**
+     * Sparse set of threads by key, in priority order, with their
+     * capture slots by position.
+     */
+    struct Threads
+    {
+        explicit Threads(Bytecode const& bytecode)
+          : sparse(bytecode.key_count(), 0)
+          , slots(bytecode.size() * bytecode.slots(), Span::npos)
+          , width(bytecode.slots())
+        {
+            dense.reserve(bytecode.size());
+        }
+
+        inline bool contains(std::size_t key) const
+        {
+            return this->sparse[key] < this->dense.size() and
+                   this->dense[this->sparse[key]].key == key;
+        }
+        inline void insert(Thread thread)
+        {
+            this->sparse[thread.key] = static_cast<Target>(this->dense.size());
+            this->dense.push_back(thread);
+            // a counted loop may hold more threads than instructions
+            if (this->slots.size() < this->dense.size() * this->width)
+                this->slots.resize(this->slots.size() * 2 + this->width);
+        }
+        inline std::size_t* slots_of(std::size_t position)
+        {
+            return this->slots.data() + position * this->width;
+        }
+        inline std::size_t size() const { return this->dense.size(); }
+        inline void clear() { this->dense.clear(); }
+
+        std::vector<Thread> dense{};
+        std::vector<Target> sparse;
+        std::vector<std::size_t> slots;
+        std::size_t width;
+    };
+
+    struct Job
+    {
+        Target pc;
+        Target count;
+        std::size_t slot;
+        std::size_t offset;
+        bool restore;
+    };
+
+    /**
+     * Follow the empty transitions from `pc' with `count', in priority
+     * order, with the capture slots in `scratch_'; assertions are checked
+     * at `offset'.
+     */
+    void add_thread_(Threads& threads,
+                     Target pc,
+                     Target count,
+                     Context context,
+                     std::size_t offset)
+    {
+        util::count(&stats::closures);
+        this->jobs_.push_back({ pc, count, 0, 0, false });
+        while (this->jobs_.size()) {
+            Job job = this->jobs_.back();
+            this->jobs_.pop_back();
+            if (job.restore) {
+                this->scratch_[job.slot] = job.offset;
+                continue;
+            }
+            pc = job.pc;
+            count = job.count;
+            for (auto key = this->bytecode_.key(pc, count);
+                 !threads.contains(key);
+                 key = this->bytecode_.key(pc, count)) {
+                threads.insert({ pc, count, key });
+                auto const& instruction = this->bytecode_[pc];
+                switch (instruction.opcode) {
+                    case Instruction::Opcode::jump:
+                        pc = instruction.x;
+                        continue;
+                    case Instruction::Opcode::split:
+                        this->jobs_.push_back(
+                          { instruction.y, count, 0, 0, false });
+                        pc = instruction.x;
+                        continue;
+                    case Instruction::Opcode::save:
+                        this->jobs_.push_back(
+                          { 0,
+                            0,
+                            instruction.y,
+                            this->scratch_[instruction.y],
+                            true });
+                        this->scratch_[instruction.y] = offset;
+                        pc = instruction.x;
+                        continue;
+                    case Instruction::Opcode::assertion:
+                        if (!this->bytecode_.holds(instruction, context))
+                            break;
+                        pc = instruction.x;
+                        continue;
+                    case Instruction::Opcode::repeat:
+                    case Instruction::Opcode::increment:
+                    case Instruction::Opcode::leave: {
+                        auto next =
+                          this->bytecode_.step_count(instruction, count);
+                        if (!next)
+                            break;
+                        count = *next;
+                        pc = instruction.x;
+                        continue;
+                    }
+                    case Instruction::Opcode::character:
+                    case Instruction::Opcode::set:
+                    case Instruction::Opcode::match:
+                        std::ranges::copy(
+                          this->scratch_, threads.slots_of(threads.size() - 1));
+                        break;
+                }
+                break;
+            }
+        }
+    }
+
+  private:
+    Bytecode const& bytecode_;
+    Threads current_;
+    Threads next_;
+    std::vector<std::size_t> scratch_;
+    std::vector<Job> jobs_{};
+    // capture slots of the match, kept to reuse their storage
+    std::vector<std::size_t> matched_{};
+};
+
+} // namespace util
+} // namespace amat
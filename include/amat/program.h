@@ -0,0 +1,780 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <amat/ast.h>
+#include <amat/backtrack.h>
+#include <amat/bytecode.h>
+#include <amat/dfa.h>
+#include <amat/glushkov.h>
+#include <amat/literal.h>
+#include <amat/onepass.h>
+#include <amat/parser.h>
+#include <amat/pike.h>
+
+namespace amat {
+
+class program;
+
+/**
+ * Resources a `amat::program' may take, for patterns and inputs that are
+ * not trusted. Each bound holds whatever the pattern: compiling throws
+ * past `max_states' or `max_threads', and the DFAs, whole, lazy or
+ * one-pass, never hold more than `max_dfa_bytes'. A program that only fits with its
+ * counted repetitions kept as loops, for lack of DFAs, runs on the Pike
+ * VM alone. A lazy DFA that builds more than `max_work_per_byte'
+ * instructions per byte scanned gives way to the Pike VM, whose time is
+ * linear in its threads, see `util::Bytecode::key_count', and in the
+ * size of the input.
+ */
+struct limits
+{
+    // instructions of each compiled program, counted repetitions kept as
+    // loops
+    std::size_t max_states = util::Bytecode::max_size;
+    // threads the Pike VM and the backtracker tell apart in a program
+    // with counters: its instructions, each once per count in a loop
+    std::size_t max_threads = std::size_t{ 1 } << 21;
+    // tables and subsets of each DFA, one-pass included
+    std::size_t max_dfa_bytes = std::size_t{ 4 } << 20;
+    // lazy DFA work between flushes, 0 for no bound
+    std::size_t max_work_per_byte = 1024;
+};
+
+/**
+ * Mutable state of the engines that build it while matching, for one
+ * `amat::program': the lazy DFA caches, and the visited bitmap, threads
+ * and capture slots of the backtracker and the Pike VM. The program is
+ * immutable and may be shared by threads; keep one scratch per thread
+ * and reuse it across calls, so the states built and the storage grown
+ * by one call serve the next.
+ */
+class scratch
+{
+  public:
+    scratch() = delete;
+    explicit scratch(program const& owner) noexcept
+      : owner_(&owner)
+    {
+    }
+
+  private:
+    friend class program;
+
+    program const* owner_;
+    std::optional<util::Lazy_DFA> dfa_{};
+    std::optional<util::Lazy_DFA> search_dfa_{};
+    std::optional<util::Lazy_DFA> reverse_dfa_{};
+    std::optional<util::Backtracker> backtracker_{};
+    std::optional<util::Pike_VM> pike_vm_{};
+    std::optional<util::Pike_VM> search_pike_vm_{};
+    std::optional<util::Pike_VM> reverse_pike_vm_{};
+};
+
+/**
+ * Compiled regular expression. The pattern is simplified and analyzed
+ * once, from its postfix form and compiled sizes, and each call is
+ * dispatched to the fastest engine that supports it. Searches run an
+ * unanchored copy of the program, led by any bytes unless the pattern
+ * starts with `^'; the span of a match is found by a reversed copy,
+ * followed by any bytes, that gives its leftmost start, then the longest
+ * match from there. Patterns that denote a finite set of strings skip
+ * the automata and run on `util::Literal_Set'. Every engine stays within
+ * the `amat::limits' given.
+ */
+class program
+{
+  public:
+    enum class Engine
+    {
+        literal,
+        bit_parallel,
+        dfa,
+        lazy_dfa,
+        one_pass,
+        backtrack,
+        pike_vm
+    };
+
+    struct Analysis
+    {
+        static constexpr std::size_t unbounded = Span::npos;
+
+        // operands, i.e. states of the position automaton
+        std::size_t positions = 0;
+        std::size_t groups = 0;
+        std::size_t assertions = 0;
+        // only single bytes and concatenation
+        bool literal = true;
+        // every match begins at the start of the input
+        bool anchored = false;
+        // bytes found in every match, e.g. `cd' in `(ab)*cd(ef)*'
+        std::string required{};
+        // of a match, in bytes, or `unbounded'
+        std::size_t longest = 0;
+    };
+
+    program() = delete;
+    program(program const&) = delete;
+    explicit program(std::string_view source,
+                     Flags flags = Flags::none,
+                     limits bounds = {})
+      : limits_(bounds)
+      , postfix_(util::simplify(Parser{ source, flags }.postfix()))
+      , bytecode_(compile_(this->postfix_, false, bounds))
+      , counted_bytecode_(
+          counted_(this->postfix_, false, this->bytecode_, bounds))
+      , search_postfix_(util::simplify(this->postfix_, false))
+    {
+        struct Operand
+        {
+            // with counted repetitions unrolled as they are by the automata
+            std::size_t positions;
+            bool anchored;
+            std::size_t longest;
+            // the only string matched, if any; else bytes that begin, end
+            // and occur in every match
+            std::optional<std::string> exact{};
+            std::string prefix{};
+            std::string suffix{};
+            std::string required{};
+
+            void clear_strings()
+            {
+                this->exact.reset();
+                this->prefix.clear();
+                this->suffix.clear();
+                this->required.clear();
+            }
+        };
+        constexpr auto unbounded = Analysis::unbounded;
+        std::vector<Operand> operands{};
+        auto pop = [&operands]() {
+            auto top = std::move(operands.back());
+            operands.pop_back();
+            return top;
+        };
+        auto longer = [](std::string const& a, std::string const& b) {
+            return a.size() >= b.size() ? a : b;
+        };
+        for (auto const& item : util::construct_byte_postfix(this->postfix_)) {
+            switch (item.type) {
+                case Item::Type::T_CONCAT: {
+                    auto right = pop();
+                    auto& left = operands.back();
+                    left.positions += right.positions;
+                    left.longest =
+                      left.longest == unbounded or right.longest == unbounded
+                        ? unbounded
+                        : left.longest + right.longest;
+                    left.required =
+                      longer(longer(left.required, right.required),
+                             left.suffix + right.prefix);
+                    if (left.exact)
+                        left.prefix = *left.exact + right.prefix;
+                    if (right.exact)
+                        left.suffix += *right.exact;
+                    else
+                        left.suffix = right.suffix;
+                    if (left.exact and right.exact)
+                        *left.exact += *right.exact;
+                    else
+                        left.exact.reset();
+                    break;
+                }
+                case Item::Type::T_UNION: {
+                    this->analysis_.literal = false;
+                    auto right = pop();
+                    auto& left = operands.back();
+                    left.positions += right.positions;
+                    left.anchored &= right.anchored;
+                    left.longest = std::max(left.longest, right.longest);
+                    if (left.exact != right.exact)
+                        left.exact.reset();
+                    // common prefix and suffix of the alternatives
+                    auto prefix =
+                      std::ranges::mismatch(left.prefix, right.prefix).in1;
+                    left.prefix.erase(prefix, left.prefix.end());
+                    auto suffix = std::ranges::mismatch(
+                                    left.suffix | std::views::reverse,
+                                    right.suffix | std::views::reverse)
+                                    .in1;
+                    left.suffix.erase(left.suffix.begin(), suffix.base());
+                    left.required = left.required == right.required
+                                      ? left.required
+                                      : longer(left.prefix, left.suffix);
+                    break;
+                }
+                case Item::Type::T_KLEENE_STAR:
+                    operands.back().longest = unbounded;
+                    [[fallthrough]];
+                case Item::Type::T_OPTIONAL:
+                    operands.back().anchored = false;
+                    operands.back().clear_strings();
+                    this->analysis_.literal = false;
+                    break;
+                case Item::Type::T_PLUS:
+                    operands.back().longest = unbounded;
+                    operands.back().exact.reset();
+                    this->analysis_.literal = false;
+                    break;
+                case Item::Type::T_REPEAT: {
+                    this->analysis_.literal = false;
+                    auto& operand = operands.back();
+                    operand.positions *= item.bounds.max == Bounds::unbounded
+                                           ? std::max(item.bounds.min, 1u)
+                                           : std::max(item.bounds.max, 1u);
+                    if (item.bounds.max == Bounds::unbounded)
+                        operand.longest = unbounded;
+                    else if (operand.longest != unbounded)
+                        operand.longest *= item.bounds.max;
+                    if (item.bounds.min == 0) {
+                        operand.anchored = false;
+                        operand.clear_strings();
+                    } else if (item.bounds.min != item.bounds.max) {
+                        operand.exact.reset();
+                    } else if (operand.exact) {
+                        std::string repeated{};
+                        for (unsigned i = 0; i < item.bounds.min; i++)
+                            repeated += *operand.exact;
+                        operand.exact = repeated;
+                        operand.prefix = repeated;
+                        operand.suffix = repeated;
+                        operand.required = repeated;
+                    }
+                    break;
+                }
+                case Item::Type::T_GROUP:
+                    break;
+                case Item::Type::T_ASSERTION:
+                    this->analysis_.assertions++;
+                    this->analysis_.literal = false;
+                    operands.push_back(
+                      { 0, item.assertion == Assertion::begin_text, 0, "" });
+                    break;
+                case Item::Type::T_SET: {
+                    Operand operand{ 1, false, 1 };
+                    if (item.set.count() != 1) {
+                        this->analysis_.literal = false;
+                    } else {
+                        std::size_t byte = 0;
+                        while (!item.set.test(byte))
+                            byte++;
+                        operand.exact = std::string(1, static_cast<char>(byte));
+                        operand.prefix = *operand.exact;
+                        operand.suffix = *operand.exact;
+                        operand.required = *operand.exact;
+                    }
+                    operands.push_back(std::move(operand));
+                    break;
+                }
+            }
+        }
+        if (operands.size()) {
+            this->analysis_.positions = operands.back().positions;
+            this->analysis_.anchored = operands.back().anchored;
+            this->analysis_.required = operands.back().required;
+            this->analysis_.longest = operands.back().longest;
+        }
+        this->analysis_.groups = this->bytecode_.groups;
+
+        // searches only need the language of the pattern, not its groups
+        Postfix reverse_postfix = this->search_postfix_;
+        Postfix any{ { Item::Type::T_SET, Byte_Set{}.set() },
+                     { Item::Type::T_KLEENE_STAR } };
+        if (!this->analysis_.anchored) {
+            if (this->postfix_.size())
+                this->search_postfix_.push_back({ Item::Type::T_CONCAT });
+            this->search_postfix_.insert(
+              this->search_postfix_.begin(), any.begin(), any.end());
+        }
+        this->search_bytecode_ =
+          compile_(this->search_postfix_, false, bounds);
+        this->counted_search_bytecode_ = counted_(
+          this->search_postfix_, false, this->search_bytecode_, bounds);
+
+        reverse_postfix.insert(reverse_postfix.end(), any.begin(), any.end());
+        if (this->postfix_.size())
+            reverse_postfix.push_back({ Item::Type::T_CONCAT });
+        this->reverse_bytecode_ =
+          compile_(reverse_postfix, true, bounds);
+        this->counted_reverse_bytecode_ =
+          counted_(reverse_postfix, true, this->reverse_bytecode_, bounds);
+
+        this->literal_set_ =
+          util::construct_literal_set_from_postfix(this->postfix_);
+        if (this->literal_set_) {
+            this->engine_ = Engine::literal;
+            this->search_engine_ = Engine::literal;
+        } else {
+            this->engine_ = this->select_engine_(this->postfix_,
+                                                 this->bytecode_,
+                                                 this->analysis_.positions,
+                                                 this->bit_parallel_,
+                                                 this->dfa_);
+            this->search_engine_ =
+              this->select_engine_(this->search_postfix_,
+                                   this->search_bytecode_,
+                                   this->analysis_.positions + 1,
+                                   this->search_bit_parallel_,
+                                   this->search_dfa_);
+
+            if (!this->dfa_) {
+                this->dfa_ = util::construct_DFA_from_bytecode(
+                  this->bytecode_, this->dfa_states_(this->bytecode_));
+            }
+            this->reverse_dfa_ = util::construct_DFA_from_bytecode(
+              this->reverse_bytecode_,
+              this->dfa_states_(this->reverse_bytecode_));
+        }
+
+        if (this->analysis_.groups) {
+            this->one_pass_ = util::construct_one_pass_from_bytecode(
+              this->bytecode_,
+              util::one_pass_nodes_within(bounds.max_dfa_bytes));
+        }
+    }
+
+  public:
+    /**
+     * Each call takes an optional `amat::scratch' of this program; without
+     * one, the engines that need it build their state from nothing.
+     */
+    bool match(std::string_view str) const
+    {
+        scratch cache{ *this };
+        return this->match(str, cache);
+    }
+
+    bool match(std::string_view str, scratch& cache) const
+    {
+        this->check_(cache);
+        switch (this->engine_) {
+            case Engine::literal:
+                return this->literal_set_->match(str);
+            case Engine::bit_parallel:
+                return this->bit_parallel_->match(str);
+            case Engine::dfa:
+                return this->dfa_->match(str);
+            case Engine::pike_vm:
+                return this->use_(cache.pike_vm_, this->threaded_())
+                  .match(str, {});
+            default: {
+                auto& dfa = this->lazy_(cache.dfa_, this->bytecode_);
+                if (bool found = dfa.match(str); !dfa.failed())
+                    return found;
+                return this->use_(cache.pike_vm_, this->threaded_())
+                  .match(str, {});
+            }
+        }
+    }
+
+    /**
+     * Match and write the span of each group to `groups'.
+     */
+    bool match(std::string_view str, std::span<Span> groups) const
+    {
+        scratch cache{ *this };
+        return this->match(str, groups, cache);
+    }
+
+    bool match(std::string_view str,
+               std::span<Span> groups,
+               scratch& cache) const
+    {
+        this->check_(cache);
+        switch (this->capture_engine(str.size())) {
+            case Engine::one_pass:
+                return this->one_pass_->match(str, groups);
+            case Engine::backtrack:
+                return this->use_(cache.backtracker_, this->threaded_())
+                  .match(str, groups);
+            default:
+                return this->use_(cache.pike_vm_, this->threaded_())
+                  .match(str, groups);
+        }
+    }
+
+    /**
+     * True if the pattern matches anywhere in `str', stopping at the
+     * first match found. Inputs without `Analysis::required' are
+     * rejected by a substring scan alone; for patterns of bounded length
+     * and without assertions, the engine then only runs in the windows
+     * around its occurrences that a match could span.
+     */
+    bool search(std::string_view str) const
+    {
+        scratch cache{ *this };
+        return this->search(str, cache);
+    }
+
+    bool search(std::string_view str, scratch& cache) const
+    {
+        this->check_(cache);
+        return this->earliest_(str, cache) != Span::npos;
+    }
+
+    /**
+     * Span of the match in `str' chosen by `policy'. Leftmost-longest:
+     * the reversed DFA scans back from the end for the leftmost start,
+     * then the DFA runs forward from it for the longest end. Earliest:
+     * the search stops at the first offset where a match ends, as
+     * `search' does, and the reversed DFA scans back from there for its
+     * leftmost start, so no byte after that match is read. Both run in
+     * linear time; a lazy DFA that gives up within
+     * `limits::max_work_per_byte' leaves its scan to the Pike VM.
+     */
+    template<Policy policy = Policy::leftmost_longest>
+    std::optional<Span> find(std::string_view str) const
+    {
+        scratch cache{ *this };
+        return this->find<policy>(str, cache);
+    }
+
+    template<Policy policy = Policy::leftmost_longest>
+    std::optional<Span> find(std::string_view str, scratch& cache) const
+    {
+        this->check_(cache);
+        if (this->literal_set_)
+            return this->literal_set_->find(str, policy);
+        if constexpr (policy == Policy::earliest) {
+            std::size_t end = this->earliest_(str, cache);
+            if (end == Span::npos)
+                return std::nullopt;
+            return Span{ end - this->reverse_length_(str, end, cache), end };
+        } else {
+            if (this->earliest_(str, cache) == Span::npos)
+                return std::nullopt;
+            std::size_t begin =
+              str.size() - this->reverse_length_(str, str.size(), cache);
+            std::size_t size = 0;
+            if (this->dfa_) {
+                size = this->dfa_->longest(str, begin);
+            } else if (this->bytecode_.counters.size()) {
+                size = this->use_(cache.pike_vm_, this->threaded_())
+                         .longest(str, begin);
+            } else {
+                auto& dfa = this->lazy_(cache.dfa_, this->bytecode_);
+                size = dfa.longest(str, begin);
+                if (dfa.failed())
+                    size = this->use_(cache.pike_vm_, this->threaded_())
+                             .longest(str, begin);
+            }
+            return Span{ begin, begin + size };
+        }
+    }
+
+    /**
+     * True when `match', `search' and `find' run on tables built with the
+     * program alone, so they never allocate: only the lazy DFA, taken by
+     * patterns too large for a whole DFA, builds states while matching.
+     * Captures never allocate with `Engine::one_pass'. The calls are
+     * still not `noexcept', as they check that a scratch is their
+     * program's and the lazy DFA and the Pike VM may allocate; for a
+     * `noexcept' call, run `dfa()' or `search_dfa()' directly.
+     */
+    bool allocation_free() const noexcept
+    {
+        if (this->literal_set_)
+            return true;
+        return this->engine_ != Engine::lazy_dfa and
+               this->search_engine_ != Engine::lazy_dfa and
+               this->dfa_.has_value() and this->reverse_dfa_.has_value();
+    }
+
+    inline Engine engine() const { return this->engine_; }
+    inline Engine search_engine() const { return this->search_engine_; }
+
+    Engine capture_engine(std::size_t length) const
+    {
+        if (this->one_pass_.has_value())
+            return Engine::one_pass;
+        if (util::Backtracker::fits(this->threaded_(), length))
+            return Engine::backtrack;
+        return Engine::pike_vm;
+    }
+
+    inline Analysis const& analysis() const { return this->analysis_; }
+    inline limits const& bounds() const { return this->limits_; }
+    inline Postfix const& postfix() const { return this->postfix_; }
+    inline util::Bytecode const& bytecode() const { return this->bytecode_; }
+    inline util::Bytecode const& search_bytecode() const
+    {
+        return this->search_bytecode_;
+    }
+    inline util::Bytecode const& reverse_bytecode() const
+    {
+        return this->reverse_bytecode_;
+    }
+    /**
+     * Bytecode of the Pike VM and the backtracker: `bytecode()' with its
+     * counted repetitions kept as loops, when it has any to keep.
+     */
+    inline util::Bytecode const& threaded_bytecode() const
+    {
+        return this->threaded_();
+    }
+    /**
+     * DFAs of the pattern, whenever it fits, and of its search, when it
+     * is the search engine; e.g. for `amat::serialize'. Neither is built
+     * for `Engine::literal'.
+     */
+    inline std::optional<util::DFA> const& dfa() const { return this->dfa_; }
+    inline std::optional<util::DFA> const& search_dfa() const
+    {
+        return this->search_dfa_;
+    }
+    inline std::optional<util::Literal_Set> const& literal_set() const
+    {
+        return this->literal_set_;
+    }
+
+  private:
+    /**
+     * Offset where the first match in `str' ends, or Span::npos, with the
+     * prefilter of `search': windows are scanned in order, so the first
+     * one with a match holds the match that ends first.
+     */
+    std::size_t earliest_(std::string_view str, scratch& cache) const
+    {
+        auto const& required = this->analysis_.required;
+        if (this->literal_set_ or required.empty())
+            return this->earliest_in_(str, cache);
+
+        auto hit = str.find(required);
+        if (hit == std::string_view::npos) {
+            util::count(&stats::prefilter_skips, str.size());
+            return Span::npos;
+        }
+        auto const longest = this->analysis_.longest;
+        if (this->analysis_.assertions or longest == Analysis::unbounded)
+            return this->earliest_in_(str, cache);
+
+        // a match spanning the occurrence at `hit' lies in [begin, end)
+        auto begin_of = [&](std::size_t hit) {
+            return hit + required.size() > longest
+                     ? hit + required.size() - longest
+                     : 0;
+        };
+        std::size_t covered = 0;
+        while (hit != std::string_view::npos) {
+            std::size_t begin = begin_of(hit);
+            std::size_t end = std::min(str.size(), hit + longest);
+            // windows that overlap are scanned as one
+            while ((hit = str.find(required, hit + 1)) !=
+                     std::string_view::npos and
+                   begin_of(hit) <= end)
+                end = std::min(str.size(), hit + longest);
+            util::count(&stats::prefilter_skips, begin - covered);
+            covered = end;
+            auto found =
+              this->earliest_in_(str.substr(begin, end - begin), cache);
+            if (found != Span::npos)
+                return begin + found;
+        }
+        util::count(&stats::prefilter_skips, str.size() - covered);
+        return Span::npos;
+    }
+
+    std::size_t earliest_in_(std::string_view str, scratch& cache) const
+    {
+        switch (this->search_engine_) {
+            case Engine::literal: {
+                auto found = this->literal_set_->find(str, Policy::earliest);
+                return found ? found->end : Span::npos;
+            }
+            case Engine::bit_parallel:
+                return this->search_bit_parallel_->earliest(str);
+            case Engine::dfa:
+                return this->search_dfa_->earliest(str);
+            case Engine::pike_vm:
+                return this->use_(cache.search_pike_vm_,
+                                  threaded_(this->search_bytecode_,
+                                            this->counted_search_bytecode_))
+                  .earliest(str);
+            default: {
+                auto& dfa = this->lazy_(cache.search_dfa_,
+                                        this->search_bytecode_);
+                if (auto end = dfa.earliest(str); !dfa.failed())
+                    return end;
+                return this->use_(cache.search_pike_vm_,
+                                  threaded_(this->search_bytecode_,
+                                            this->counted_search_bytecode_))
+                  .earliest(str);
+            }
+        }
+    }
+
+    /**
+     * Length of the longest run before `to' that the reversed program
+     * matches, i.e. from the leftmost start of a match that ends by it.
+     */
+    std::size_t reverse_length_(std::string_view str,
+                                std::size_t to,
+                                scratch& cache) const
+    {
+        auto pike_vm = [&]() -> util::Pike_VM& {
+            return use_(cache.reverse_pike_vm_,
+                        threaded_(this->reverse_bytecode_,
+                                  this->counted_reverse_bytecode_));
+        };
+        if (this->reverse_dfa_)
+            return this->reverse_dfa_->longest_reverse(str, to);
+        if (this->reverse_bytecode_.counters.size())
+            return pike_vm().longest_reverse(str, to);
+        auto& dfa = this->lazy_(cache.reverse_dfa_, this->reverse_bytecode_);
+        if (auto length = dfa.longest_reverse(str, to); !dfa.failed())
+            return length;
+        return pike_vm().longest_reverse(str, to);
+    }
+
+    void check_(scratch const& cache) const
+    {
+        if (cache.owner_ != this)
+            throw std::runtime_error("scratch made for another program");
+    }
+
+    /**
+     * States of a DFA of `bytecode' within `limits::max_dfa_bytes'.
+     */
+    std::size_t dfa_states_(util::Bytecode const& bytecode) const
+    {
+        return std::min(
+          util::DFA::max_states,
+          util::dfa_states_within(this->limits_.max_dfa_bytes, bytecode));
+    }
+
+    util::Lazy_DFA& lazy_(std::optional<util::Lazy_DFA>& dfa,
+                          util::Bytecode const& bytecode) const
+    {
+        if (!dfa) {
+            dfa.emplace(bytecode,
+                        this->dfa_states_(bytecode),
+                        this->limits_.max_work_per_byte);
+        }
+        return *dfa;
+    }
+
+    /**
+     * Bytecode of `postfix' for the automata, unrolled, unless it only
+     * fits in `limits::max_states' instructions with counters; throws
+     * when those take more than `limits::max_threads' threads.
+     */
+    static util::Bytecode
+    compile_(Postfix const& postfix, bool reverse, limits const& bounds)
+    {
+        if (util::unrolled_size(postfix) <= bounds.max_states) {
+            return util::construct_bytecode_from_postfix(
+              postfix, reverse, bounds.max_states);
+        }
+        auto counted = util::construct_bytecode_from_postfix(
+          postfix, reverse, bounds.max_states, true);
+        if (counted.key_count() > bounds.max_threads) {
+            throw std::runtime_error(
+              "could not construct bytecode: more than " +
+              std::to_string(bounds.max_threads) + " threads");
+        }
+        return counted;
+    }
+
+    /**
+     * Bytecode of `postfix' with counters, for the Pike VM and the
+     * backtracker, or none when `unrolled' has the same instructions or
+     * the counters take more than `limits::max_threads' threads.
+     */
+    static util::Bytecode counted_(Postfix const& postfix,
+                                   bool reverse,
+                                   util::Bytecode const& unrolled,
+                                   limits const& bounds)
+    {
+        auto repeats = [](Item const& item) {
+            return item.type == Item::Type::T_REPEAT;
+        };
+        if (unrolled.counters.size() or
+            std::ranges::none_of(postfix, repeats))
+            return {};
+        auto counted = util::construct_bytecode_from_postfix(
+          postfix, reverse, bounds.max_states, true);
+        if (counted.counters.empty() or
+            counted.key_count() > bounds.max_threads)
+            return {};
+        return counted;
+    }
+
+    static util::Bytecode const& threaded_(util::Bytecode const& unrolled,
+                                           util::Bytecode const& counted)
+    {
+        return counted.size() ? counted : unrolled;
+    }
+    inline util::Bytecode const& threaded_() const
+    {
+        return threaded_(this->bytecode_, this->counted_bytecode_);
+    }
+
+    /**
+     * Engine of a scratch, made on first use.
+     */
+    template<class Automaton>
+    static Automaton& use_(std::optional<Automaton>& engine,
+                           util::Bytecode const& bytecode)
+    {
+        if (!engine)
+            engine.emplace(bytecode);
+        return *engine;
+    }
+
+    /**
+     * Bit-parallel below 64 positions and without assertions, else the
+     * whole DFA if it fits, else the lazy DFA; the Pike VM for bytecode
+     * that only fits with counters.
+     */
+    Engine select_engine_(Postfix const& postfix,
+                          util::Bytecode const& bytecode,
+                          std::size_t positions,
+                          std::optional<util::Bit_Parallel>& bit_parallel,
+                          std::optional<util::DFA>& dfa) const
+    {
+        if (positions < util::Bit_Parallel::max_states and
+            !this->analysis_.assertions) {
+            bit_parallel.emplace(
+              util::construct_glushkov_from_postfix(postfix));
+            return Engine::bit_parallel;
+        }
+        if (bytecode.counters.size())
+            return Engine::pike_vm;
+        if ((dfa = util::construct_DFA_from_bytecode(
+               bytecode, this->dfa_states_(bytecode))))
+            return Engine::dfa;
+        return Engine::lazy_dfa;
+    }
+
+  private:
+    limits limits_;
+    Postfix postfix_;
+    util::Bytecode bytecode_;
+    util::Bytecode counted_bytecode_;
+    Postfix search_postfix_;
+    util::Bytecode search_bytecode_{};
+    util::Bytecode counted_search_bytecode_{};
+    util::Bytecode reverse_bytecode_{};
+    util::Bytecode counted_reverse_bytecode_{};
+    Analysis analysis_{};
+    Engine engine_ = Engine::pike_vm;
+    Engine search_engine_ = Engine::lazy_dfa;
+    std::optional<util::Bit_Parallel> bit_parallel_{};
+    std::optional<util::DFA> dfa_{};
+    std::optional<util::Bit_Parallel> search_bit_parallel_{};
+    std::optional<util::DFA> search_dfa_{};
+    std::optional<util::DFA> reverse_dfa_{};
+    std::optional<util::One_Pass> one_pass_{};
+    std::optional<util::Literal_Set> literal_set_{};
+};
+
+} // namespace amat
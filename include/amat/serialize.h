@@ -0,0 +1,174 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <amat/dfa.h>
+
+namespace amat {
+
+/**
+ * Header of a serialized `util::DFA'. The transition table follows at
+ * `table', aligned to a cache line, then one accepting byte per state at
+ * `accept'; every field is in the byte order of `endian'.
+ */
+struct dfa_header
+{
+    static constexpr std::array<char, 4> signature = { 'a', 'm', 'a', 't' };
+    static constexpr std::uint16_t current_version = 1;
+    static constexpr std::size_t alignment = 64;
+
+    std::array<char, 4> magic = signature;
+    std::uint16_t version = current_version;
+    // 'l' or 'b', for little and big endian
+    std::uint8_t endian = std::endian::native == std::endian::little ? 'l'
+                                                                     : 'b';
+    std::uint8_t state_size = sizeof(util::DFA::State);
+    std::uint32_t states = 0;
+    std::uint32_t start = 0;
+    std::array<std::uint32_t, 2> within{};
+    std::uint64_t table = 0;
+    std::uint64_t accept = 0;
+    std::uint64_t size = 0;
+};
+
+/**
+ * Write `dfa' as a versioned blob that `amat::dfa_view' matches from
+ * without copying.
+ */
+inline std::vector<std::byte>
+serialize(util::DFA const& dfa)
+{
+    auto align = [](std::uint64_t offset) {
+        constexpr std::uint64_t mask = dfa_header::alignment - 1;
+        return (offset + mask) & ~mask;
+    };
+
+    dfa_header header{};
+    header.states = static_cast<std::uint32_t>(dfa.size());
+    header.start = dfa.start;
+    header.within = { dfa.within[0], dfa.within[1] };
+    header.table = align(sizeof(dfa_header));
+    header.accept = header.table + dfa.table.size() * sizeof(util::DFA::State);
+    header.size = align(header.accept + dfa.size());
+
+    std::vector<std::byte> blob(header.size);
+    std::memcpy(blob.data(), &header, sizeof header);
+    std::memcpy(blob.data() + header.table,
+                dfa.table.data(),
+                dfa.table.size() * sizeof(util::DFA::State));
+    for (std::size_t state = 0; state < dfa.size(); state++) {
+        blob[header.accept + state] = std::byte{ dfa.accept[state] };
+    }
+    return blob;
+}
+
+/**
+ * Read-only `util::DFA' over a serialized blob, e.g. a mapped file: the
+ * blob is checked once, then matched in place.
+ */
+class dfa_view
+{
+  public:
+    using State = util::DFA::State;
+
+    dfa_view() = delete;
+    explicit dfa_view(std::span<std::byte const> blob)
+    {
+        if (blob.size() < sizeof(dfa_header))
+            throw std::runtime_error("dfa_view: truncated header");
+        std::memcpy(&this->header_, blob.data(), sizeof(dfa_header));
+
+        auto const& header = this->header_;
+        if (header.magic != dfa_header::signature)
+            throw std::runtime_error("dfa_view: not a serialized DFA");
+        if (header.endian != dfa_header{}.endian or
+            header.state_size != sizeof(State))
+            throw std::runtime_error(
+              "dfa_view: serialized on an incompatible platform");
+        if (header.version != dfa_header::current_version)
+            throw std::runtime_error("dfa_view: unsupported version");
+        auto const table_size =
+          std::uint64_t{ header.states } * 256 * sizeof(State);
+        // offsets are untrusted, so each is bounded before any subtraction
+        if (header.size > blob.size() or header.states == 0 or
+            header.table < sizeof(dfa_header) or
+            header.table % alignof(State) or header.accept < header.table or
+            header.accept > header.size or
+            table_size > header.accept - header.table or
+            header.states > header.size - header.accept)
+            throw std::runtime_error("dfa_view: truncated or invalid blob");
+        if (reinterpret_cast<std::uintptr_t>(blob.data() + header.table) %
+            alignof(State))
+            throw std::runtime_error("dfa_view: misaligned blob");
+
+        this->table_ =
+          reinterpret_cast<State const*>(blob.data() + header.table);
+        this->accept_ = blob.data() + header.accept;
+
+        auto valid = [&header](State state) {
+            return (state & ~util::DFA::matched) < header.states;
+        };
+        if (!valid(header.start) or !valid(header.within[0]) or
+            !valid(header.within[1]))
+            throw std::runtime_error("dfa_view: invalid start state");
+        for (std::size_t i = 0; i < header.states * std::size_t{ 256 }; i++) {
+            if (!valid(this->table_[i]))
+                throw std::runtime_error("dfa_view: invalid transition");
+        }
+    }
+
+  public:
+    inline std::size_t size() const { return this->header_.states; }
+
+    /**
+     * As `util::DFA::match'.
+     */
+    bool match(std::string_view str) const noexcept
+    {
+        State state = this->header_.start;
+        for (auto const& c : str) {
+            state = this->table_[state * 256 + static_cast<NFA::Input>(c)] &
+                    ~util::DFA::matched;
+            if (state == util::DFA::dead)
+                return false;
+        }
+        return this->accepts_(state);
+    }
+
+    /**
+     * As `util::DFA::search'.
+     */
+    bool search(std::string_view str) const noexcept
+    {
+        State state = this->header_.start;
+        for (auto const& c : str) {
+            state = this->table_[state * 256 + static_cast<NFA::Input>(c)];
+            if (state & util::DFA::matched)
+                return true;
+            if (state == util::DFA::dead)
+                return false;
+        }
+        return this->accepts_(state);
+    }
+
+  private:
+    inline bool accepts_(State state) const noexcept
+    {
+        return this->accept_[state] != std::byte{ 0 };
+    }
+
+  private:
+    dfa_header header_{};
+    State const* table_ = nullptr;
+    std::byte const* accept_ = nullptr;
+};
+
+} // namespace amat
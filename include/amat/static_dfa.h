@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace amat {
+
+/**
+ * DFA with its tables fixed at compile time, as emitted by `amat_compile'
+ * in the layout of `amat::util::DFA': `matched' flags a transition taken
+ * after a match and state 0 is dead. It needs nothing else from the
+ * library, and matches in constant expressions too.
+ */
+template<std::size_t States>
+struct static_dfa
+{
+    using State = std::uint32_t;
+
+    static constexpr State dead = 0;
+    static constexpr State matched = State{ 1 } << 31;
+
+    std::array<State, States * 256> table;
+    std::array<bool, States> accept;
+    State start;
+
+  public:
+    constexpr bool match(std::string_view str) const noexcept
+    {
+        State state = this->start;
+        for (auto const& c : str) {
+            state = this->table[state * 256 + static_cast<unsigned char>(c)] &
+                    ~matched;
+            if (state == dead)
+                return false;
+        }
+        return this->accept[state];
+    }
+
+    constexpr bool search(std::string_view str) const noexcept
+    {
+        State state = this->start;
+        for (auto const& c : str) {
+            state = this->table[state * 256 + static_cast<unsigned char>(c)];
+            if (state & matched)
+                return true;
+            if (state == dead)
+                return false;
+        }
+        return this->accept[state];
+    }
+};
+
+} // namespace amat
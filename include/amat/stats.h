@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace amat {
+
+/**
+ * Counters of the matching engines on the calling thread. They are only
+ * kept when built with `AMAT_STATS' defined; otherwise every count
+ * compiles to nothing and the counters stay zero. Define it for every
+ * translation unit of a program or for none: the inline engines are
+ * compiled differently with and without it, so a program that mixes
+ * both breaks the one-definition rule, and the linker may keep either
+ * version of each engine.
+ */
+struct stats
+{
+    // input bytes read by the engines, again when backtracking
+    std::size_t bytes_scanned = 0;
+    // states added to a DFA, whole or lazy
+    std::size_t dfa_states = 0;
+    // transitions of a lazy DFA read from its cache or computed
+    std::size_t cache_hits = 0;
+    std::size_t cache_misses = 0;
+    // lazy DFA caches flushed when full
+    std::size_t cache_flushes = 0;
+    // input bytes passed over by a prefilter without running an engine
+    std::size_t prefilter_skips = 0;
+    // empty closures, of DFA subsets and of Pike VM threads
+    std::size_t closures = 0;
+    // steps of the Pike VM and bit-parallel engines, the sum of their
+    // active threads or positions, and the most at any step
+    std::size_t steps = 0;
+    std::size_t active = 0;
+    std::size_t max_active = 0;
+};
+
+// the same in every translation unit, see `stats'
+#ifdef AMAT_STATS
+inline constexpr bool stats_enabled = true;
+#else
+inline constexpr bool stats_enabled = false;
+#endif
+
+inline stats&
+thread_stats() noexcept
+{
+    static thread_local stats counters{};
+    return counters;
+}
+
+inline void
+reset_stats() noexcept
+{
+    thread_stats() = {};
+}
+
+namespace util {
+
+inline void
+count(std::size_t stats::*counter, std::size_t n = 1) noexcept
+{
+    if constexpr (stats_enabled)
+        thread_stats().*counter += n;
+}
+
+/**
+ * One step of an engine with `n' active threads or positions.
+ */
+inline void
+count_step(std::size_t n) noexcept
+{
+    if constexpr (stats_enabled) {
+        auto& counters = thread_stats();
+        counters.steps++;
+        counters.active += n;
+        counters.max_active = std::max(counters.max_active, n);
+    }
+}
+
+} // namespace util
+} // namespace amat
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
 #include <amat/nfa.h>
-#include <ranges>
 
 namespace amat {
 namespace util {
@@ -70,7 +73,7 @@ struct Simulator
     std::vector<Edge::Node> on{};
 };
 
-States
+inline States
 epsilon_closure(NFA const& nfa, Edge::Node const& state)
 {
     States next{};
@@ -100,7 +103,7 @@ epsilon_closure(NFA const& nfa, Edge::Node const& state)
     return next;
 }
 
-States
+inline States
 epsilon_closure(NFA const& nfa, States& states)
 {
     States next{};
@@ -110,7 +113,7 @@ epsilon_closure(NFA const& nfa, States& states)
     return next;
 }
 
-States
+inline States
 transition(NFA const& nfa, States const& states, NFA::Input symbol)
 {
     States next{};
@@ -7,8 +7,13 @@ enum class Token : unsigned short
     T_OPEN_PAREN = 1,
     T_CLOSE_PAREN,
     T_KLEENE_STAR,
+    T_PLUS,
+    T_OPTIONAL,
+    T_REPEAT,
     T_UNION,
     T_CHAR,
+    T_SET,
+    T_ASSERTION,
     T_UNKNOWN,
     T_END
 };
@@ -23,10 +28,20 @@ token_as_string(Token token)
             return "T_CLOSE_PAREN";
         case Token::T_KLEENE_STAR:
             return "T_KLEENE_STAR";
+        case Token::T_PLUS:
+            return "T_PLUS";
+        case Token::T_OPTIONAL:
+            return "T_OPTIONAL";
+        case Token::T_REPEAT:
+            return "T_REPEAT";
         case Token::T_UNION:
             return "T_UNION";
         case Token::T_CHAR:
             return "T_CHAR";
+        case Token::T_SET:
+            return "T_SET";
+        case Token::T_ASSERTION:
+            return "T_ASSERTION";
         case Token::T_UNKNOWN:
             return "T_UNKNOWN";
         case Token::T_END:
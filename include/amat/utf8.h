@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace amat {
+
+/**
+ * Set of Unicode codepoints as sorted, disjoint and non-adjacent ranges.
+ * Surrogates are never members, since they have no UTF-8 encoding.
+ */
+struct Code_Set
+{
+    using Range = std::pair<char32_t, char32_t>;
+
+    static constexpr char32_t max = 0x10FFFF;
+    static constexpr Range surrogates = { 0xD800, 0xDFFF };
+
+    std::vector<Range> ranges{};
+
+  public:
+    void insert(char32_t low, char32_t high)
+    {
+        if (low <= surrogates.first and high >= surrogates.first) {
+            if (high > surrogates.second)
+                this->insert(surrogates.second + 1, high);
+            if (low == surrogates.first)
+                return;
+            high = surrogates.first - 1;
+        } else if (low >= surrogates.first and low <= surrogates.second) {
+            if (high <= surrogates.second)
+                return;
+            low = surrogates.second + 1;
+        }
+
+        auto it = std::ranges::lower_bound(
+          this->ranges, low, {}, [](Range const& range) {
+              return range.second + 1;
+          });
+        while (it != this->ranges.end() and it->first <= high + 1) {
+            low = std::min(low, it->first);
+            high = std::max(high, it->second);
+            it = this->ranges.erase(it);
+        }
+        this->ranges.insert(it, { low, high });
+    }
+
+    void insert(Code_Set const& other)
+    {
+        for (auto const& [low, high] : other.ranges) {
+            this->insert(low, high);
+        }
+    }
+
+    /**
+     * Complement within [from, max].
+     */
+    void negate(char32_t from = 0)
+    {
+        Code_Set complement{};
+        char32_t next = from;
+        for (auto const& [low, high] : this->ranges) {
+            if (high < from)
+                continue;
+            if (low > next)
+                complement.insert(next, low - 1);
+            next = high + 1;
+        }
+        if (next <= max)
+            complement.insert(next, max);
+        *this = std::move(complement);
+    }
+
+    std::size_t count() const
+    {
+        std::size_t count = 0;
+        for (auto const& [low, high] : this->ranges) {
+            count += high - low + 1;
+        }
+        return count;
+    }
+
+    inline bool empty() const { return this->ranges.empty(); }
+    inline void clear() { this->ranges.clear(); }
+
+    friend bool operator==(Code_Set const&, Code_Set const&) = default;
+};
+
+namespace util {
+
+/**
+ * Byte ranges taken in order by a UTF-8 sequence, one per byte.
+ */
+using UTF8_Sequence = std::vector<std::pair<unsigned char, unsigned char>>;
+
+/**
+ * Write the UTF-8 encoding of `code' to `bytes' and return its length.
+ */
+constexpr std::size_t
+encode_utf8(char32_t code, std::array<unsigned char, 4>& bytes)
+{
+    if (code < 0x80) {
+        bytes[0] = static_cast<unsigned char>(code);
+        return 1;
+    }
+    std::size_t length = code < 0x800 ? 2 : code < 0x10000 ? 3 : 4;
+    for (auto i = length - 1; i > 0; i--) {
+        bytes[i] = static_cast<unsigned char>(0x80 | (code & 0x3F));
+        code >>= 6;
+    }
+    bytes[0] = static_cast<unsigned char>((0xF00 >> length) | code);
+    return length;
+}
+
+/**
+ * Codepoint and length of the UTF-8 sequence at the front of `str', or
+ * std::nullopt when it is not valid: truncated, overlong, a surrogate or
+ * past U+10FFFF.
+ */
+constexpr std::optional<std::pair<char32_t, std::size_t>>
+decode_utf8(std::string_view str)
+{
+    if (str.empty())
+        return std::nullopt;
+    auto lead = static_cast<unsigned char>(str[0]);
+    std::size_t length = lead < 0x80   ? 1
+                         : lead < 0xC2 ? 0
+                         : lead < 0xE0 ? 2
+                         : lead < 0xF0 ? 3
+                         : lead < 0xF5 ? 4
+                                       : 0;
+    if (length == 0 or length > str.size())
+        return std::nullopt;
+
+    char32_t code = length == 1 ? lead : lead & (0x7F >> length);
+    for (std::size_t i = 1; i < length; i++) {
+        auto byte = static_cast<unsigned char>(str[i]);
+        if ((byte & 0xC0) != 0x80)
+            return std::nullopt;
+        code = code << 6 | (byte & 0x3F);
+    }
+    constexpr char32_t least[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (code < least[length] or code > Code_Set::max or
+        (code >= Code_Set::surrogates.first and
+         code <= Code_Set::surrogates.second))
+        return std::nullopt;
+    return std::pair{ code, length };
+}
+
+/**
+ * Split [low, high] into ranges whose UTF-8 encodings differ only by
+ * their byte ranges, so each is matched byte by byte with no decoding:
+ * e.g. [U+0080, U+07FF] is [C2-DF][80-BF]. Sequences come in codepoint
+ * order.
+ */
+inline std::vector<UTF8_Sequence>
+construct_utf8_sequences(char32_t low, char32_t high)
+{
+    std::vector<UTF8_Sequence> sequences{};
+    std::vector<Code_Set::Range> stack{ { low, high } };
+
+    auto split = [&stack](char32_t low, char32_t middle, char32_t high) {
+        stack.push_back({ middle + 1, high });
+        stack.push_back({ low, middle });
+    };
+
+    while (stack.size()) {
+        auto [low, high] = stack.back();
+        stack.pop_back();
+
+        // one encoded length
+        bool divided = false;
+        for (char32_t boundary : { 0x7F, 0x7FF, 0xFFFF }) {
+            if (low <= boundary and boundary < high) {
+                split(low, boundary, high);
+                divided = true;
+                break;
+            }
+        }
+        // every continuation byte over its whole range
+        for (std::size_t i = 1; i < 4 and !divided; i++) {
+            char32_t mask = (char32_t{ 1 } << (6 * i)) - 1;
+            if ((low & ~mask) == (high & ~mask))
+                continue;
+            if (low & mask) {
+                split(low, low | mask, high);
+                divided = true;
+            } else if ((high & mask) != mask) {
+                split(low, (high & ~mask) - 1, high);
+                divided = true;
+            }
+        }
+        if (divided)
+            continue;
+
+        std::array<unsigned char, 4> from{};
+        std::array<unsigned char, 4> to{};
+        auto length = encode_utf8(low, from);
+        encode_utf8(high, to);
+        UTF8_Sequence sequence{};
+        for (std::size_t i = 0; i < length; i++) {
+            sequence.push_back({ from[i], to[i] });
+        }
+        sequences.push_back(std::move(sequence));
+    }
+    return sequences;
+}
+
+} // namespace util
+} // namespace amat
@@ -1,12 +1,51 @@
 #include <amat/amat.h>
+#include <amat/helpers.h>
+#include <amat/mapped_file.h>
+#include <amat/static_dfa.h>
 
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <new>
+#include <random>
+
+#include "test_patterns.h"
 
 using namespace amat;
 
+// test/unit.cc
+bool
+search_in_unit(std::string_view);
+
+// every allocation of the test binary, for "amat::program : no allocation"
+static std::atomic<std::size_t> allocations{ 0 };
+
+void*
+operator new(std::size_t size)
+{
+    allocations++;
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc{};
+}
+
+void
+operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void
+operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
 struct NFA_Fixture
 {
     NFA nfa;
@@ -17,7 +56,7 @@ struct NFA_Fixture
 
 Edge::Node
 assert_and_get_state_exists_by_id(std::set<Edge::Node> const& items,
-                                  unsigned short id)
+                                  State::Id id)
 {
     auto search = std::ranges::find_if(
       items.begin(), items.end(), [&id](Edge::Node const& search) -> bool {
@@ -329,3 +368,1168 @@ TEST_CASE("amat::match")
     print<"abc|def">();
     CHECK(match<"abc|aaa">("abc") == true);
 }
+
+TEST_CASE("amat::Parser::postfix")
+{
+    auto postfix = [](std::string_view source) {
+        return postfix_as_string(Parser{ source }.postfix());
+    };
+    CHECK(postfix("a*bb") == "a*b.b.");
+    CHECK(postfix("aac*bb") == "aa.c*.b.b.");
+    CHECK(postfix("(ab)*|cd|abc") == "ab.)*cd.|ab.c.|");
+    CHECK(postfix("a(b|c)*d") == "abc|)*.d.");
+    CHECK_THROWS(Parser{ "(ab" }.postfix());
+    CHECK_THROWS(Parser{ "a|*" }.postfix());
+}
+
+TEST_CASE("amat::util::construct_glushkov_from_regular_expression")
+{
+    auto automaton = util::construct_glushkov_from_regular_expression("a*|bb");
+    CHECK(automaton.size() == 4);
+    CHECK(automaton.follow[0] == util::Glushkov::Positions{ 1, 2 });
+    CHECK(automaton.follow[1] == util::Glushkov::Positions{ 1 });
+    CHECK(automaton.follow[2] == util::Glushkov::Positions{ 3 });
+    CHECK(automaton.last == util::Glushkov::Positions{ 0, 1, 3 });
+}
+
+TEST_CASE("amat::util::Bit_Parallel")
+{
+    util::Bit_Parallel engine{ util::construct_glushkov_from_regular_expression(
+      "(ab)*|cd|abc") };
+    CHECK(engine.match("") == true);
+    CHECK(engine.match("ababab") == true);
+    CHECK(engine.match("cd") == true);
+    CHECK(engine.match("abc") == true);
+    CHECK(engine.match("aba") == false);
+    CHECK(engine.match("cdcd") == false);
+    CHECK_THROWS(util::Bit_Parallel{
+      util::construct_glushkov_from_regular_expression(std::string(64, 'a')) });
+}
+
+TEST_CASE("amat::match : bit-parallel")
+{
+    CHECK(match<"abc|def">("def") == true);
+    CHECK(match<"abc|def">("abd") == false);
+    CHECK(match<"(ab)*|cd|abc">("ababab") == true);
+    CHECK(match<"a*|bb">("b") == false);
+    CHECK(match<"a*|bb">("bb") == true);
+    CHECK(match<"a*|bb">("") == true);
+    CHECK(match<"a(b|c)*d">("abcbcd") == true);
+    CHECK(match<"a(b|c)*d">("abcba") == false);
+}
+
+TEST_CASE("amat::util::construct_bytecode_from_regular_expression")
+{
+    auto bytecode = util::construct_bytecode_from_regular_expression("(a(b))*");
+    CHECK(bytecode.groups == 2);
+    CHECK(bytecode[bytecode.start].opcode == util::Instruction::Opcode::split);
+    CHECK(bytecode.instructions.back().opcode ==
+          util::Instruction::Opcode::match);
+}
+
+TEST_CASE("amat::match_groups")
+{
+    static_assert(count_capture_groups("(a(b))*|c") == 2);
+
+    auto groups = match_groups<"(a(b))*|c">("abab");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0) == Span{ 2, 4 });
+    CHECK(groups->at(1) == Span{ 3, 4 });
+
+    groups = match_groups<"(a(b))*|c">("c");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0).matched() == false);
+    CHECK(groups->at(1).matched() == false);
+
+    CHECK(match_groups<"(a(b))*|c">("aba").has_value() == false);
+
+    auto fields = match_groups<"(a*)(ab)*(b*)">("aabb");
+    REQUIRE(fields.has_value());
+    CHECK(fields->at(0) == Span{ 0, 2 });
+    CHECK(fields->at(1).matched() == false);
+    CHECK(fields->at(2) == Span{ 2, 4 });
+
+    CHECK(match_groups<"(a*)*">("aaa").has_value() == true);
+}
+
+TEST_CASE("amat::util::Pike_VM")
+{
+    auto bytecode =
+      util::construct_bytecode_from_regular_expression("(a*)(ab)*(b*)");
+    util::Pike_VM vm{ bytecode };
+    std::array<Span, 3> groups{};
+    REQUIRE(vm.match("aabb", groups));
+    CHECK(groups[0] == Span{ 0, 2 });
+    CHECK(groups[1].matched() == false);
+    CHECK(groups[2] == Span{ 2, 4 });
+    CHECK(vm.match("aaba", groups) == false);
+
+    // a pathological pattern for backtracking stays linear
+    auto nested = util::construct_bytecode_from_regular_expression("(a*)*b");
+    util::Pike_VM linear{ nested };
+    CHECK(linear.match(std::string(10000, 'a'), {}) == false);
+    CHECK(linear.match(std::string(10000, 'a') + "b", {}) == true);
+}
+
+TEST_CASE("amat::match : Pike VM")
+{
+    // more than 64 positions does not fit a bit-parallel word; the VM is
+    // run directly, as a program would take the DFA
+    std::string long_literal = "abcdefghijklmnopqrstuvwxyz"
+                               "abcdefghijklmnopqrstuvwxyz"
+                               "abcdefghijklmnopqrstuvwxyz";
+    auto bytecode =
+      util::construct_bytecode_from_regular_expression(long_literal + "|x*");
+    util::Pike_VM pike_vm{ bytecode };
+    CHECK(pike_vm.match(long_literal, {}) == true);
+    CHECK(pike_vm.match("xxx", {}) == true);
+    CHECK(pike_vm.match("abc", {}) == false);
+
+    // not one-pass, and too long an input for the backtracker
+    std::string text{};
+    for (auto i = 0; i < 50000; i++)
+        text += "ab";
+    REQUIRE(program{ "(ab|a)*(b*)(c)" }.capture_engine(text.size() + 1) ==
+            program::Engine::pike_vm);
+    auto groups = match_groups<"(ab|a)*(b*)(c)">(text + "d");
+    CHECK(groups.has_value() == false);
+    groups = match_groups<"(ab|a)*(b*)(c)">(text + "c");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0) == Span{ 99998, 100000 });
+    CHECK(groups->at(1) == Span{ 100000, 100000 });
+    CHECK(groups->at(2) == Span{ 100000, 100001 });
+}
+
+TEST_CASE("amat::util::construct_one_pass_from_bytecode")
+{
+    auto one_pass = util::construct_one_pass_from_bytecode(
+      util::construct_bytecode_from_regular_expression("(ab)*c(d*)"));
+    REQUIRE(one_pass.has_value());
+    std::array<Span, 2> groups{};
+    REQUIRE(one_pass->match("ababcdd", groups));
+    CHECK(groups[0] == Span{ 2, 4 });
+    CHECK(groups[1] == Span{ 5, 7 });
+    CHECK(one_pass->match("abab", groups) == false);
+    CHECK(one_pass->match("", groups) == false);
+
+    CHECK(util::construct_one_pass_from_bytecode(
+            util::construct_bytecode_from_regular_expression("(a*)(ab)*"))
+            .has_value() == false);
+    CHECK(util::construct_one_pass_from_bytecode(
+            util::construct_bytecode_from_regular_expression("(a*)*"))
+            .has_value() == false);
+
+    // one node per byte consumed, then the accepting one
+    auto bytecode = util::construct_bytecode_from_regular_expression("(abc)");
+    CHECK(util::construct_one_pass_from_bytecode(bytecode, 4).has_value());
+    CHECK(util::construct_one_pass_from_bytecode(bytecode, 3).has_value() ==
+          false);
+}
+
+TEST_CASE("amat::util::construct_DFA_from_bytecode")
+{
+    auto bytecode = util::construct_bytecode_from_regular_expression("a*|bb");
+    auto dfa = util::construct_DFA_from_bytecode(bytecode);
+    REQUIRE(dfa.has_value());
+    CHECK(dfa->match("") == true);
+    CHECK(dfa->match("aaa") == true);
+    CHECK(dfa->match("bb") == true);
+    CHECK(dfa->match("b") == false);
+    CHECK(dfa->match("ab") == false);
+    CHECK(util::construct_DFA_from_bytecode(bytecode, 2).has_value() == false);
+}
+
+TEST_CASE("amat::util::Lazy_DFA")
+{
+    auto bytecode =
+      util::construct_bytecode_from_regular_expression("(a|b)*abb(a|b)*");
+    util::Lazy_DFA dfa{ bytecode };
+    CHECK(dfa.match("babba") == true);
+    CHECK(dfa.match("babab") == false);
+
+    // closures share one set of marks, cleared by moving to a generation
+    util::Closure_Marks marks{ bytecode };
+    marks.next();
+    CHECK(marks.mark(bytecode.start) == true);
+    CHECK(marks.mark(bytecode.start) == false);
+    marks.next();
+    CHECK(marks.mark(bytecode.start) == true);
+
+    // a cache too small for the whole DFA is flushed while matching
+    util::Lazy_DFA small{ bytecode, 4 };
+    CHECK(small.match("aaaaabababbaaa") == true);
+    CHECK(small.size() <= 4);
+    CHECK(small.match("aaaaabababab") == false);
+}
+
+TEST_CASE("amat::program")
+{
+    program short_pattern{ "(ab)*|cd|abc" };
+    CHECK(short_pattern.engine() == program::Engine::bit_parallel);
+    CHECK(short_pattern.analysis().positions == 7);
+    CHECK(short_pattern.analysis().groups == 1);
+    CHECK(short_pattern.analysis().literal == false);
+    CHECK(program{ "abc" }.analysis().literal == true);
+
+    std::string alternatives{ "a" };
+    for (auto i = 0; i < 64; i++)
+        alternatives += "|a[bc]";
+    program large_pattern{ alternatives };
+    CHECK(large_pattern.engine() == program::Engine::dfa);
+    CHECK(large_pattern.match("ab") == true);
+    CHECK(large_pattern.match("abab") == false);
+
+    std::array<Span, 1> groups{};
+    CHECK(short_pattern.capture_engine(4) == program::Engine::backtrack);
+    CHECK(program{ "(ab)*|cd" }.capture_engine(4) ==
+          program::Engine::one_pass);
+    REQUIRE(short_pattern.match("abab", groups));
+    CHECK(groups[0] == Span{ 2, 4 });
+    CHECK(program{ "(a*)(ab)*" }.capture_engine(4) ==
+          program::Engine::backtrack);
+    CHECK(program{ "(a*)(ab)*" }.capture_engine(1 << 20) ==
+          program::Engine::pike_vm);
+}
+
+TEST_CASE("amat::Lexer : byte sets")
+{
+    auto set_of = [](std::string_view source) {
+        Lexer lexer{ source };
+        lexer.get_next_token();
+        REQUIRE(*lexer == Token::T_SET);
+        return lexer.set();
+    };
+    CHECK(set_of(".").count() == 127);
+    CHECK(set_of("[a-z]").count() == 26);
+    CHECK(set_of("[^a-z]").count() == 102);
+    CHECK(set_of("[]a-]").count() == 3);
+    CHECK(set_of("[\\d_]").count() == 11);
+    CHECK(set_of("\\w").count() == 63);
+    CHECK(set_of("\\S").count() == 122);
+
+    Lexer escaped{ "\\.\\x41" };
+    CHECK(escaped.get_next_token() == Token::T_CHAR);
+    CHECK(escaped.scanner() == '.');
+    CHECK(escaped.get_next_token() == Token::T_CHAR);
+    CHECK(escaped.scanner() == 'A');
+
+    CHECK_THROWS(set_of("[a-"));
+    CHECK_THROWS(set_of("[z-a]"));
+    static_assert(count_capture_groups("\\((a)[(]") == 1);
+}
+
+TEST_CASE("amat::match : byte sets")
+{
+    CHECK(postfix_as_string(Parser{ "[0-9]x." }.postfix()) ==
+          "[10]x.[1112063].");
+    CHECK(match<"[0-9][0-9]*\\.[0-9]*">("3.14") == true);
+    CHECK(match<"[0-9][0-9]*\\.[0-9]*">("3x14") == false);
+    CHECK(match<"\\d\\d*-\\w*">("2024-log_line") == true);
+    CHECK(match<"\\d\\d*-\\w*">("-log") == false);
+    CHECK(match<"a.c">("a\nc") == false);
+    CHECK(match<"a.c">("a-c") == true);
+    CHECK(match<"[^ ]* [^ ]*">("GET /index") == true);
+
+    auto groups = match_groups<"(\\d\\d*)\\.(\\d\\d*)">("10.25");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0) == Span{ 0, 2 });
+    CHECK(groups->at(1) == Span{ 3, 5 });
+
+    program classes{ "[a-z][a-z]*" };
+    CHECK(classes.bytecode().size() == 4);
+    CHECK(classes.bytecode().sets.size() == 2);
+    CHECK(classes.analysis().literal == false);
+}
+
+TEST_CASE("amat::match : counted repetition")
+{
+    CHECK(postfix_as_string(Parser{ "ab+c?" }.postfix()) == "ab+.c?.");
+    CHECK(postfix_as_string(Parser{ "a{2,3}b{2,}" }.postfix()) ==
+          "a{2,3}b{2,}.");
+    CHECK(postfix_as_string(Parser{ "a{,2}" }.postfix()) == "a{.,.2.}.");
+    CHECK_THROWS(Parser{ "a{3,2}" }.postfix());
+    CHECK_THROWS(Parser{ "a{1001}" }.postfix());
+    CHECK_THROWS(Parser{ "+a" }.postfix());
+
+    CHECK(match<"ab+c?">("abbb") == true);
+    CHECK(match<"ab+c?">("abc") == true);
+    CHECK(match<"ab+c?">("ac") == false);
+    CHECK(match<"(ab){2}">("abab") == true);
+    CHECK(match<"(ab){2}">("ababab") == false);
+    CHECK(match<"a{2,}">("a") == false);
+    CHECK(match<"a{2,}">("aaaaa") == true);
+    CHECK(match<"x[0-9]{1,3}">("x123") == true);
+    CHECK(match<"x[0-9]{1,3}">("x1234") == false);
+    CHECK(match<"x[0-9]{1,3}">("x") == false);
+    CHECK(match<"a{0}b">("b") == true);
+    CHECK(match<"a{0}b">("ab") == false);
+
+    auto groups = match_groups<"(a|b){2,3}c">("abbc");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0) == Span{ 2, 3 });
+
+    // unrolled into copies of the operand when compiled
+    program counted{ "[a-z]{3,5}" };
+    CHECK(counted.postfix().size() == 2);
+    CHECK(counted.analysis().positions == 5);
+    CHECK(counted.bytecode().groups == 0);
+    CHECK(counted.match("abcd") == true);
+    CHECK(program{ "(ab|cd){40}" }.engine() == program::Engine::dfa);
+    program looped{ "x([0-9]{2,30})" };
+    CHECK(looped.bytecode().counters.empty());
+    CHECK(looped.threaded_bytecode().counters.size() == 1);
+    CHECK(looped.threaded_bytecode().size() < looped.bytecode().size());
+    std::array<Span, 1> digits{};
+    CHECK(looped.match("x0123", digits));
+    CHECK(digits[0] == Span{ 1, 5 });
+
+    for (auto const& source : { "(a|b){2,3}c", "(ab)+a?", "a{0}b" }) {
+        auto bytecode =
+          util::construct_bytecode_from_regular_expression(source);
+        std::array<Span, 1> slots{};
+        CHECK(util::Pike_VM{ bytecode }.match("abbc", slots) ==
+              util::Backtracker{ bytecode }.match("abbc", slots));
+    }
+
+    // kept as loops on counters for the Pike VM and the backtracker,
+    // which find the same matches and groups as with the copies
+    std::mt19937 random{ 32 };
+    for (auto const& source : { "(a|b){2,7}c",
+                                "(ab|a){3,}(b*)",
+                                "((a)|b?){2,6}",
+                                "x(a{3}|b){2,}y?",
+                                "\\b[ab]{5,9}\\b",
+                                "(a{0,6})(a{2,})",
+                                "((ab){2,4}|a){0,3}" }) {
+        auto postfix = Parser{ source }.postfix();
+        auto unrolled = util::construct_bytecode_from_postfix(postfix);
+        auto counted = util::construct_bytecode_from_postfix(
+          postfix, false, util::Bytecode::max_size, true);
+        CHECK(counted.counters.size() > 0);
+        CHECK(counted.size() < unrolled.size());
+        CHECK(util::unrolled_size(postfix) == unrolled.size());
+        REQUIRE(counted.groups == unrolled.groups);
+        for (auto i = 0; i < 300; i++) {
+            std::string input(random() % 16, 'a');
+            for (auto& c : input)
+                c = "aabbxy c"[random() % 8];
+            std::vector<Span> expected(unrolled.groups), pike(counted.groups),
+              backtracked(counted.groups);
+            bool found = util::Pike_VM{ unrolled }.match(input, expected);
+            CHECK(util::Pike_VM{ counted }.match(input, pike) == found);
+            CHECK(util::Backtracker{ counted }.match(input, backtracked) ==
+                  found);
+            CHECK(pike == expected);
+            CHECK(backtracked == expected);
+        }
+    }
+}
+
+TEST_CASE("amat::Lexer : assertions")
+{
+    Lexer lexer{ "^\\b\\B$\\\\b" };
+    for (auto assertion : { Assertion::begin_text,
+                            Assertion::word_boundary,
+                            Assertion::not_word_boundary,
+                            Assertion::end_text }) {
+        CHECK(lexer.get_next_token() == Token::T_ASSERTION);
+        CHECK(lexer.assertion() == assertion);
+    }
+    CHECK(lexer.get_next_token() == Token::T_CHAR);
+    CHECK(lexer.get_next_token() == Token::T_CHAR);
+    CHECK(postfix_as_string(Parser{ "^a\\b|b$" }.postfix()) ==
+          "^a.\\b.b$.|");
+    CHECK_THROWS(util::construct_glushkov_from_regular_expression("^a"));
+}
+
+TEST_CASE("amat::search")
+{
+    CHECK(search<"b+c">("aabbcd") == true);
+    CHECK(search<"b+c">("aabbd") == false);
+    CHECK(search<"">("abc") == true);
+    CHECK(search<"^ab">("abc") == true);
+    CHECK(search<"^b">("ab") == false);
+    CHECK(search<"a$">("ba") == true);
+    CHECK(search<"a$">("ab") == false);
+    CHECK(search<"\\bfoo\\b">("a foo b") == true);
+    CHECK(search<"\\bfoo\\b">("afoo b") == false);
+    CHECK(search<"\\bfoo\\b">("a foobar") == false);
+    CHECK(search<"o\\B">("foo bar") == true);
+    CHECK(search<"x\\B">("ax ay") == false);
+    CHECK(search<"(^|,)b">("a,b") == true);
+
+    CHECK(match<"^abc$">("abc") == true);
+    CHECK(match<"a^bc">("abc") == false);
+    CHECK(match<"a\\b.*">("a b") == true);
+    CHECK(match<"a\\b.*">("ab") == false);
+    CHECK(match<"[a-z]*\\b">("word") == true);
+
+    program anchored{ "^ab|^cd" };
+    CHECK(anchored.analysis().anchored == true);
+    // factored as `^(ab|cd)'
+    CHECK(anchored.analysis().assertions == 1);
+    CHECK(anchored.search_bytecode().size() == anchored.bytecode().size());
+    CHECK(anchored.search_engine() == program::Engine::dfa);
+    CHECK(program{ "^ab|cd" }.analysis().anchored == false);
+    CHECK(program{ "(^a)*b" }.analysis().anchored == false);
+    CHECK(program{ "abc" }.search_engine() == program::Engine::literal);
+    CHECK(program{ "ab*c" }.search_engine() == program::Engine::bit_parallel);
+
+    // every engine agrees on assertions
+    for (auto const& [source, input] :
+         { std::pair{ "(\\w+)\\b.*", "ab cd" },
+           std::pair{ "(a|ab)(c|bcd)$", "abcd" },
+           std::pair{ "(^a|b)+", "ab" } }) {
+        program compiled{ source };
+        std::array<Span, 1> pike{}, backtrack{};
+        bool expected = compiled.match(input);
+        CHECK(util::Lazy_DFA{ compiled.bytecode() }.match(input) == expected);
+        CHECK(util::Pike_VM{ compiled.bytecode() }.match(input, pike) ==
+              expected);
+        CHECK(util::Backtracker{ compiled.bytecode() }.match(
+                input, backtrack) == expected);
+        CHECK(pike[0] == backtrack[0]);
+        CHECK(compiled.capture_engine(0) != program::Engine::one_pass);
+    }
+}
+
+TEST_CASE("amat::util::construct_utf8_sequences")
+{
+    auto as_string = [](std::vector<util::UTF8_Sequence> const& sequences) {
+        std::string output{};
+        char buffer[8]{};
+        for (auto const& sequence : sequences) {
+            for (auto const& [low, high] : sequence) {
+                std::snprintf(buffer, sizeof buffer, "[%02X-%02X]", low, high);
+                output += buffer;
+            }
+            output.push_back(' ');
+        }
+        return output;
+    };
+    CHECK(as_string(util::construct_utf8_sequences(0x80, 0x7FF)) ==
+          "[C2-DF][80-BF] ");
+    CHECK(as_string(util::construct_utf8_sequences(0x61, 0x100)) ==
+          "[61-7F] [C2-C3][80-BF] [C4-C4][80-80] ");
+    CHECK(util::construct_utf8_sequences(0x80, Code_Set::max).size() == 6);
+
+    Code_Set non_ascii{};
+    non_ascii.negate(0x80);
+    std::size_t sequences = 0;
+    for (auto const& [low, high] : non_ascii.ranges) {
+        sequences += util::construct_utf8_sequences(low, high).size();
+    }
+    CHECK(sequences == 8);
+
+    std::array<unsigned char, 4> bytes{};
+    CHECK(util::encode_utf8(U'é', bytes) == 2);
+    CHECK(util::decode_utf8("é") == std::pair{ char32_t{ 0xE9 }, 2ul });
+    CHECK(util::decode_utf8("\U0001F600!")->second == 4);
+    CHECK(!util::decode_utf8("\xC0\xAF").has_value());
+    CHECK(!util::decode_utf8("\xED\xA0\x80").has_value());
+    CHECK(!util::decode_utf8("\xE2\x82").has_value());
+
+    Code_Set codes{};
+    codes.insert(0xD000, 0xE000);
+    CHECK(codes.ranges.size() == 2);
+    codes.insert(0xD7FF, 0xE001);
+    CHECK(codes.count() == 0xE001 - 0xD000 + 1 - 2048);
+}
+
+TEST_CASE("amat::match : UTF-8")
+{
+    Lexer lexer{ "é[α-ωx]\\u{1F600}\\xE9" };
+    for (auto count : { 1ul, 26ul, 1ul, 1ul }) {
+        CHECK(lexer.get_next_token() == Token::T_SET);
+        CHECK(lexer.set().count() + lexer.codes().count() == count);
+    }
+    CHECK_THROWS(Parser{ "\\u{110000}" }.postfix());
+    CHECK_THROWS(Parser{ "[ω-α]" }.postfix());
+
+    CHECK(match<"café">("café") == true);
+    CHECK(match<"caf.">("café") == true);
+    CHECK(match<"caf..">("café") == false);
+    CHECK(match<"é+">("ééé") == true);
+    CHECK(match<"é+">("é\xC3") == false);
+    CHECK(match<"[α-ω]{3}">("αβγ") == true);
+    CHECK(match<"[^a-z]">("日") == true);
+    CHECK(match<"[^a-z]">("\xFF") == false);
+    CHECK(match<"\\W\\S">("\U0001F600é") == true);
+    CHECK(match<"\\xE9\\u00E9">("éé") == true);
+    CHECK(match<"a\xFF">("a\xFF") == true);
+    CHECK(search<"日本">("log: 日本語") == true);
+
+    auto groups = match_groups<"(.)(.*)">("été");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0) == Span{ 0, 2 });
+
+    program any{ "." };
+    CHECK(any.postfix().size() == 1);
+    CHECK(any.analysis().positions == 27);
+    CHECK(any.analysis().literal == false);
+    CHECK(program{ "été" }.analysis().literal == true);
+}
+
+TEST_CASE("amat::match : icase")
+{
+    CHECK(postfix_as_string(Parser{ "ab", icase }.postfix()) == "[2][2].");
+    CHECK(postfix_as_string(Parser{ "[a-c1]", icase }.postfix()) == "[7]");
+    CHECK(postfix_as_string(Parser{ "é", icase }.postfix()) == "[2]");
+    CHECK(postfix_as_string(Parser{ "\\d", icase }.postfix()) == "[10]");
+
+    CHECK(match<"error: [a-z]+", icase>("ERROR: Disk") == true);
+    CHECK(match<"error: [a-z]+">("ERROR: Disk") == false);
+    CHECK(match<"straße", icase>("STRAßE") == true);
+    CHECK(match<"ÉTÉ|σ", icase>("été") == true);
+    CHECK(match<"ÉTÉ|σ", icase>("Σ") == true);
+    CHECK(match<"привет", icase>("ПРИВЕТ") == true);
+    CHECK(search<"\\bwarn", icase>("a WARNING") == true);
+    CHECK(search<"x", icase>("abc") == false);
+
+    auto groups = match_groups<"(A+)(b)", icase>("aAB");
+    REQUIRE(groups.has_value());
+    CHECK(groups->at(0) == Span{ 0, 2 });
+    CHECK(groups->at(1) == Span{ 2, 3 });
+}
+
+TEST_CASE("amat::find")
+{
+    CHECK(find<"abcd|c">("xabcd") == Span{ 1, 5 });
+    CHECK(find<"a+">("baaab") == Span{ 1, 4 });
+    CHECK(find<"a*">("baaab") == Span{ 0, 0 });
+    CHECK(find<"\\d+">("no digits").has_value() == false);
+    CHECK(find<"$">("ab") == Span{ 2, 2 });
+    CHECK(find<"">("ab") == Span{ 0, 0 });
+    CHECK(find<"^b">("bab") == Span{ 0, 1 });
+    CHECK(find<"b$">("bab") == Span{ 2, 3 });
+    CHECK(find<"\\bfo+">("afoo foo") == Span{ 5, 8 });
+    CHECK(find<"é+">("aéé!") == Span{ 1, 5 });
+    CHECK(find<"warn|error", icase>("[x] ERROR: y") == Span{ 4, 9 });
+    CHECK(find<"(ab){2,}">("ababababx") == Span{ 0, 8 });
+
+    auto bytecode = util::construct_bytecode_from_postfix(
+      Parser{ "^ab*c" }.postfix(), true);
+    auto reverse = util::construct_DFA_from_bytecode(bytecode);
+    REQUIRE(reverse.has_value());
+    CHECK(reverse->match("cbbba") == true);
+    CHECK(reverse->match("abbbc") == false);
+    CHECK(reverse->longest_reverse("abbcx", 4) == 4);
+    CHECK(reverse->longest_reverse("xabbc", 5) == Span::npos);
+
+    // the lazy DFA takes the same two scans
+    program pattern{ "[a-c]+d" };
+    CHECK(util::Lazy_DFA{ pattern.reverse_bytecode() }.longest_reverse(
+            "xxabcdab", 8) == 6);
+    CHECK(util::Lazy_DFA{ pattern.bytecode() }.longest("xxabcdab", 2) == 4);
+    CHECK(pattern.find("xxabcdab") == Span{ 2, 6 });
+    CHECK(util::construct_byte_ranges(pattern.bytecode()) ==
+          std::vector<std::size_t>{ 0, 'a', 'd', 'e', 256 });
+}
+
+TEST_CASE("amat::serialize")
+{
+    program pattern{ "\\b(error|warn)[a-z]*:" };
+    auto dfa = util::construct_DFA_from_bytecode(pattern.search_bytecode());
+    REQUIRE(dfa.has_value());
+    auto blob = serialize(dfa.value());
+
+    dfa_header header{};
+    std::memcpy(&header, blob.data(), sizeof header);
+    CHECK(header.table % dfa_header::alignment == 0);
+    CHECK(blob.size() % dfa_header::alignment == 0);
+    CHECK(header.states == dfa->size());
+
+    dfa_view view{ blob };
+    CHECK(view.size() == dfa->size());
+    for (auto input : { "12:00 warning: disk", "errors", "xerror:", "" }) {
+        CHECK(view.search(input) == dfa->search(input));
+        CHECK(view.search(input) == pattern.search(input));
+        CHECK(view.match(input) == dfa->match(input));
+    }
+
+    auto corrupt = [&blob](std::size_t offset, std::byte value) {
+        auto copy = blob;
+        copy[offset] = value;
+        return copy;
+    };
+    CHECK_THROWS(dfa_view{ corrupt(0, std::byte{ 'A' }) });
+    CHECK_THROWS(dfa_view{ corrupt(4, std::byte{ 9 }) });
+    CHECK_THROWS(dfa_view{ corrupt(6, std::byte{ 'x' }) });
+    CHECK_THROWS(dfa_view{ corrupt(header.table + 1, std::byte{ 0x7f }) });
+    CHECK_THROWS(dfa_view{ std::span{ blob }.first(blob.size() - 64) });
+    CHECK_THROWS(dfa_view{ std::span{ blob }.subspan(1) });
+
+    // offsets that wrap around, or overlap the header
+    auto offsets = [](std::uint64_t table,
+                      std::uint32_t states,
+                      std::uint64_t accept,
+                      std::uint64_t size) {
+        std::vector<std::byte> copy(0x480);
+        dfa_header forged{};
+        forged.states = states;
+        forged.table = table;
+        forged.accept = accept;
+        forged.size = size;
+        std::memcpy(copy.data(), &forged, sizeof forged);
+        return copy;
+    };
+    CHECK_THROWS(dfa_view{ offsets(~std::uint64_t{ 63 }, 1, 0x3c0, 0x400) });
+    CHECK_THROWS(dfa_view{ offsets(0, 1, 0x400, 0x480) });
+    CHECK_THROWS(dfa_view{ offsets(0x40, 1, 0x20, 0x480) });
+    CHECK_THROWS(dfa_view{ offsets(0x40, 1, 0x480, 0x440) });
+    CHECK_THROWS(dfa_view{ offsets(0x40, 1, 0x43c, 0x480) });
+    CHECK_THROWS(dfa_view{ offsets(0x40, 1, 0x480, 0x480) });
+    CHECK_NOTHROW(dfa_view{ offsets(0x40, 1, 0x440, 0x480) });
+
+    auto path = std::filesystem::temp_directory_path() / "amat_test.dfa";
+    std::ofstream{ path, std::ios::binary }.write(
+      reinterpret_cast<char const*>(blob.data()),
+      static_cast<std::streamsize>(blob.size()));
+    {
+        mapped_file file{ path.string() };
+        dfa_view mapped{ file.bytes() };
+        CHECK(mapped.search("12:00 warning: disk") == true);
+        CHECK(mapped.search("no match") == false);
+    }
+    std::filesystem::remove(path);
+    CHECK_THROWS(mapped_file{ path.string() });
+}
+
+TEST_CASE("amat_compile")
+{
+    static_assert(test_patterns::identifier::match("snake_case_1"));
+    static_assert(!test_patterns::identifier::match("1st"));
+    static_assert(test_patterns::number::search("pi is 3.14"));
+
+    auto check = [](auto pattern, std::string_view source) {
+        program compiled{ source };
+        for (std::string_view input :
+             { "", "cat", "a cat!", "concat", "-12.5", "x_1", "αβγ", "Ω" }) {
+            CHECK(pattern.match(input) == compiled.match(input));
+            CHECK(pattern.search(input) == compiled.search(input));
+        }
+    };
+    check(test_patterns::identifier{}, "[A-Za-z_][A-Za-z0-9_]*");
+    check(test_patterns::number{}, "-?[0-9]+(\\.[0-9]+)?");
+    check(test_patterns::word_boundary{}, "\\bcat\\b");
+    check(test_patterns::greek{}, "[α-ω]+");
+    // a final backslash in the source comment splices no line into it
+    check(test_patterns::slash{}, "a\\\\");
+    static_assert(test_patterns::slash::match("a\\"));
+}
+
+TEST_CASE("amat::stats")
+{
+    REQUIRE(stats_enabled);
+    auto bytecode =
+      util::construct_bytecode_from_regular_expression("(a|b)*abb(a|b)*");
+
+    reset_stats();
+    auto dfa = util::construct_DFA_from_bytecode(bytecode);
+    CHECK(thread_stats().dfa_states == dfa->size());
+    CHECK(thread_stats().closures > 0);
+    CHECK(dfa->match("babba") == true);
+    CHECK(thread_stats().bytes_scanned == 5);
+
+    // a dead state stops the scan
+    reset_stats();
+    CHECK(dfa->match("abbcaaaa") == false);
+    CHECK(thread_stats().bytes_scanned == 4);
+
+    reset_stats();
+    util::Lazy_DFA small{ bytecode, 4 };
+    CHECK(small.match("aaaaabababbaaa") == true);
+    auto const& counters = thread_stats();
+    CHECK(counters.bytes_scanned == 14);
+    CHECK(counters.cache_hits + counters.cache_misses == 14);
+    CHECK(counters.cache_misses > 0);
+    CHECK(counters.cache_flushes > 0);
+
+    reset_stats();
+    std::array<Span, 1> groups{};
+    CHECK(util::Pike_VM{ bytecode }.match("abb", groups) == true);
+    CHECK(thread_stats().bytes_scanned == 3);
+    CHECK(thread_stats().steps == 4);
+    CHECK(thread_stats().max_active >= 2);
+    CHECK(thread_stats().active >= thread_stats().steps);
+}
+
+TEST_CASE("amat::util::export_dot and export_json")
+{
+    auto bytecode =
+      util::construct_bytecode_from_regular_expression("a[b-d]|\\bx\"");
+    auto dfa = util::construct_DFA_from_bytecode(bytecode);
+    REQUIRE(dfa.has_value());
+
+    std::string dot{};
+    util::export_dot(*dfa, std::back_inserter(dot));
+    CHECK(dot.starts_with("digraph dfa {\n  // states: 7, table entries: "
+                          "1792, memory: 7169 bytes\n"));
+    CHECK(dot.find("  6 [shape=doublecircle];\n") != std::string::npos);
+    CHECK(dot.find("  4 -> 6 [label=\"b-d\"];\n") != std::string::npos);
+    CHECK(dot.find("  5 -> 6 [label=\"\\\"\"];\n") != std::string::npos);
+    CHECK(dot.ends_with("}\n"));
+
+    // into a fixed buffer, without allocating
+    std::array<char, 4096> buffer{};
+    auto end = util::export_json(*dfa, buffer.data());
+    std::string_view json{ buffer.data(), end };
+    CHECK(json.starts_with("{\"type\":\"dfa\",\"states\":7,\"table_entries\":"
+                           "1792,\"memory_bytes\":7169,\"start\":1,"));
+    CHECK(json.find("{\"from\":4,\"to\":6,\"bytes\":[[98,100]]}") !=
+          std::string_view::npos);
+
+    std::string program{};
+    util::export_json(bytecode, std::back_inserter(program));
+    CHECK(program ==
+          "{\"type\":\"bytecode\",\"instructions\":7,\"sets\":1,\"groups\":0,"
+          "\"memory_bytes\":116,\"start\":5,\"program\":["
+          "{\"op\":\"character\",\"byte\":97,\"x\":1},"
+          "{\"op\":\"set\",\"set\":0,\"bytes\":[[98,100]],\"x\":6},"
+          "{\"op\":\"assertion\",\"assertion\":\"\\\\b\",\"x\":3},"
+          "{\"op\":\"character\",\"byte\":120,\"x\":4},"
+          "{\"op\":\"character\",\"byte\":34,\"x\":6},"
+          "{\"op\":\"split\",\"y\":2,\"x\":0},"
+          "{\"op\":\"match\"}]}\n");
+    program.clear();
+    util::export_dot(bytecode, std::back_inserter(program));
+    CHECK(program.find("  5 -> 2 [style=dashed];\n") != std::string::npos);
+
+    // loops of counted repetitions name their counter
+    auto counted = util::construct_bytecode_from_postfix(
+      Parser{ "a{2,9}" }.postfix(), false, util::Bytecode::max_size, true);
+    program.clear();
+    util::export_json(counted, std::back_inserter(program));
+    CHECK(program.ends_with("\"start\":1,\"program\":["
+                            "{\"op\":\"character\",\"byte\":97,\"x\":3},"
+                            "{\"op\":\"split\",\"y\":4,\"x\":2},"
+                            "{\"op\":\"repeat\",\"counter\":0,\"x\":0},"
+                            "{\"op\":\"increment\",\"counter\":0,\"x\":1},"
+                            "{\"op\":\"leave\",\"counter\":0,\"x\":5},"
+                            "{\"op\":\"match\"}]}\n"));
+    program.clear();
+    util::export_dot(counted, std::back_inserter(program));
+    CHECK(program.find("  2 [label=\"2: repeat c0\", shape=box];\n") !=
+          std::string::npos);
+}
+
+TEST_CASE("amat.h : several translation units")
+{
+    CHECK(search_in_unit("xababc") == true);
+    CHECK(search_in_unit("xac") == false);
+    CHECK(search<"(ab)+c">("ababc") == true);
+
+    // built on use, not by a static initializer in each unit
+    CHECK(ascii().count() == 128);
+    CHECK(ascii().test(127));
+    CHECK_FALSE(ascii().test(128));
+}
+
+TEST_CASE("amat::program : no allocation")
+{
+    program pattern{ "(error|warn)[a-z]*: ([0-9]+)" };
+    REQUIRE(pattern.allocation_free());
+    REQUIRE(pattern.capture_engine(0) == program::Engine::one_pass);
+    program large{ "\\b[a-z]+ing\\b" };
+    REQUIRE(large.allocation_free());
+    auto blob = serialize(
+      util::construct_DFA_from_bytecode(pattern.search_bytecode()).value());
+    dfa_view view{ blob };
+
+    // the tables are noexcept, the program calls that may take a lazy
+    // DFA or check a scratch are not
+    REQUIRE(large.search_engine() == program::Engine::dfa);
+    auto const& dfa = *pattern.dfa();
+    static_assert(noexcept(dfa.match(std::string_view{})));
+    auto const& search_dfa = *large.search_dfa();
+    static_assert(noexcept(search_dfa.search(std::string_view{})));
+    static_assert(noexcept(view.search(std::string_view{})));
+    static_assert(
+      noexcept(test_patterns::identifier::search(std::string_view{})));
+    static_assert(!noexcept(pattern.match(std::string_view{})));
+
+    std::array<Span, 2> groups{};
+    std::string_view line = "12:00 warning: 42 retries";
+    std::size_t found = 0;
+    auto before = allocations.load();
+    for (auto i = 0; i < 100; i++) {
+        found += pattern.match("error: 7");
+        found += pattern.search(line);
+        found += pattern.find(line).has_value();
+        found += pattern.match("warn: 12", groups);
+        found += large.search("a boring line");
+        found += view.search(line);
+    }
+    CHECK(allocations.load() == before);
+    CHECK(found == 600);
+    CHECK(groups[1] == Span{ 6, 8 });
+}
+
+TEST_CASE("amat::scratch")
+{
+    // too many states for a whole DFA, so matched by the lazy DFA
+    program large{ "(a|b)*a(a|b){40}" };
+    REQUIRE(large.engine() == program::Engine::lazy_dfa);
+    REQUIRE(large.search_engine() == program::Engine::lazy_dfa);
+    program groups_pattern{ "((a|ab)(c|bcd))(d*)" };
+    REQUIRE(groups_pattern.capture_engine(1 << 16) == program::Engine::pike_vm);
+
+    std::vector<std::string> inputs{
+        std::string(50, 'a'), std::string(30, 'b') + std::string(41, 'a'),
+        "ab", "ba"
+    };
+    std::string long_input = "abc" + std::string(1 << 16, 'd');
+
+    scratch cache{ large };
+    scratch capture_cache{ groups_pattern };
+    std::array<Span, 4> groups{};
+    std::array<Span, 4> expected{};
+    auto run = [&]() {
+        for (auto const& input : inputs) {
+            CHECK(large.match(input, cache) == large.match(input));
+            CHECK(large.search(input, cache) == large.search(input));
+            CHECK(large.find(input, cache) == large.find(input));
+        }
+        CHECK(groups_pattern.match(long_input, groups, capture_cache) ==
+              groups_pattern.match(long_input, expected));
+        CHECK(groups == expected);
+    };
+    run();
+    CHECK(groups[3].end == long_input.size());
+
+    // once warm, a scratch serves the same calls without allocating
+    auto before = allocations.load();
+    for (auto const& input : inputs) {
+        large.match(input, cache);
+        large.search(input, cache);
+        large.find(input, cache);
+    }
+    groups_pattern.match(long_input, groups, capture_cache);
+    CHECK(allocations.load() == before);
+    run();
+
+    CHECK_THROWS(groups_pattern.match("abc", cache));
+}
+
+TEST_CASE("amat::limits")
+{
+    // counted repetitions are unrolled, so the bytecode is capped; one
+    // that only fits as a loop on a counter runs on the Pike VM alone
+    CHECK_THROWS(program{ "((a{1000}){1000}){1000}" });
+    CHECK_THROWS(program{ "a{100}", Flags::none, { .max_states = 4 } });
+    CHECK_NOTHROW(program{ "a{100}", Flags::none, { .max_states = 200 } });
+    program looped{ "a{100}", Flags::none, { .max_states = 50 } };
+    CHECK(looped.bytecode().counters.size() == 1);
+    CHECK(looped.engine() == program::Engine::pike_vm);
+    CHECK(looped.search_engine() == program::Engine::pike_vm);
+    CHECK_FALSE(looped.dfa().has_value());
+    CHECK(looped.match(std::string(100, 'a')));
+    CHECK_FALSE(looped.match(std::string(99, 'a')));
+    CHECK(looped.find("b" + std::string(150, 'a')) == Span{ 1, 101 });
+    CHECK(looped.find<Policy::earliest>("b" + std::string(150, 'a')) ==
+          Span{ 1, 101 });
+
+    // each instruction of a loop counts once per count against
+    // `max_threads', as do the copies of the loops that are unrolled
+    CHECK_THROWS(program{ "((a{1000}){1000}){20}" });
+    CHECK_THROWS(program{
+      "a{100}", Flags::none, { .max_states = 50, .max_threads = 500 } });
+    CHECK_NOTHROW(program{
+      "a{100}", Flags::none, { .max_states = 50, .max_threads = 600 } });
+    // a one-pass DFA past `max_dfa_bytes' leaves captures to the others
+    std::string const source = "(x)(ab{20}c){3}";
+    std::string input = "x";
+    for (auto i = 0; i < 3; i++)
+        input += "a" + std::string(20, 'b') + "c";
+    program one_pass{ source };
+    program narrow{ source, Flags::none, { .max_dfa_bytes = 1 << 12 } };
+    CHECK(one_pass.capture_engine(input.size()) == program::Engine::one_pass);
+    CHECK(narrow.capture_engine(input.size()) != program::Engine::one_pass);
+    std::array<Span, 2> wide_groups{}, narrow_groups{};
+    REQUIRE(one_pass.match(input, wide_groups));
+    REQUIRE(narrow.match(input, narrow_groups));
+    CHECK(narrow_groups == wide_groups);
+    CHECK(narrow_groups[1] == Span{ 45, 67 });
+
+    // counters are only an option when the unrolled program fits
+    program unrolled{ "x([0-9]{2,30})", Flags::none, { .max_threads = 16 } };
+    CHECK(unrolled.threaded_bytecode().counters.empty());
+    CHECK(unrolled.match("x0123"));
+
+    // more instructions than an `unsigned short' can number
+    program wide{ "(a{1000}){70}" };
+    CHECK(wide.bytecode().size() > 70000);
+    CHECK(wide.match(std::string(70000, 'a')));
+    CHECK_FALSE(wide.match(std::string(69999, 'a')));
+
+    // too many instructions unrolled, as few with the inner loop counted
+    program deep{ "(a{1000}){300}" };
+    CHECK(deep.engine() == program::Engine::pike_vm);
+    CHECK(deep.bytecode().size() < 2500);
+    CHECK(deep.match(std::string(300000, 'a')));
+    CHECK_FALSE(deep.match(std::string(299999, 'a')));
+
+    // a DFA that does not fit in `max_dfa_bytes' is built lazily
+    std::string pair = "(ab|cd){40}";
+    CHECK(program{ pair }.engine() == program::Engine::dfa);
+    program small{ pair, Flags::none, { .max_dfa_bytes = 1 << 12 } };
+    CHECK(small.engine() == program::Engine::lazy_dfa);
+    CHECK_FALSE(small.match("abcd"));
+    std::string pairs{};
+    for (auto i = 0; i < 40; i++)
+        pairs += i % 3 ? "ab" : "cd";
+    CHECK(small.match(pairs));
+    CHECK(small.find("x" + pairs + "ab") == Span{ 1, 81 });
+
+    // past `max_work_per_byte', every call gives way to the Pike VM
+    std::mt19937 random{ 45 };
+    for (std::string pattern :
+         { "(a|b)*a(a|b){40}", "\\b(a|b)*a(a|b){40}\\b|^b+ $" }) {
+        program bounded{ pattern,
+                         Flags::none,
+                         { .max_dfa_bytes = 1 << 10, .max_work_per_byte = 1 } };
+        program unbounded{ pattern, Flags::none, { .max_work_per_byte = 0 } };
+        REQUIRE(bounded.engine() == program::Engine::lazy_dfa);
+        for (auto length : { 10, 41, 42, 100, 1000 }) {
+            std::string input(length, 'a');
+            for (auto& c : input)
+                c = "ab"[random() % 2];
+            input[length / 4] = ' ';
+            for (auto const& text : { input, input + "c", " " + input }) {
+                CHECK(bounded.match(text) == unbounded.match(text));
+                CHECK(bounded.search(text) == unbounded.search(text));
+                CHECK(bounded.find(text) == unbounded.find(text));
+                CHECK(bounded.find<Policy::earliest>(text) ==
+                      unbounded.find<Policy::earliest>(text));
+            }
+        }
+        std::string input(1000, 'b');
+        for (std::size_t i = 0; i < input.size(); i += 3)
+            input[i] = 'a';
+        input[input.size() - 41] = 'a';
+        CHECK(unbounded.find(input).has_value());
+        CHECK(bounded.find(input) == unbounded.find(input));
+    }
+}
+
+TEST_CASE("amat::util::Literal_Set")
+{
+    program keywords{ "GET|POST|PUT|PATCH|DELETE|HEAD" };
+    REQUIRE(keywords.engine() == program::Engine::literal);
+    CHECK(keywords.literal_set()->literals.size() == 6);
+    CHECK(keywords.allocation_free());
+    CHECK(keywords.match("PATCH") == true);
+    CHECK(keywords.match("PATC") == false);
+    CHECK(keywords.search("a HEAD request") == true);
+    CHECK(keywords.find("x PUTPATCH") == Span{ 2, 5 });
+    CHECK(program{ "(ab|cd)(ef|gh)" }.literal_set()->literals.size() == 4);
+    CHECK_FALSE(program{ "ab*" }.literal_set().has_value());
+    CHECK_FALSE(program{ "ab", icase }.literal_set().has_value());
+    CHECK_FALSE(program{ "" }.literal_set().has_value());
+
+    // bytes that start no literal are skipped, by `memchr' for one
+    reset_stats();
+    CHECK(program{ "needle|nail" }.search(std::string(1000, 'x') + "nail"));
+    if constexpr (stats_enabled)
+        CHECK(thread_stats().prefilter_skips == 1000);
+
+    // agrees with the automata, kept by an equivalent counted repetition
+    std::mt19937 random{ 46 };
+    for (std::string source :
+         { "abcd|c", "a|ab|abc|bc", "aab|ab|b", "abab", "b(a|ab)c", "été|t" }) {
+        program literal{ source };
+        program automaton{ "(" + source + "){1}" };
+        REQUIRE(literal.engine() == program::Engine::literal);
+        REQUIRE(automaton.engine() != program::Engine::literal);
+        for (auto i = 0; i < 300; i++) {
+            std::string input(random() % 12, 'a');
+            for (auto& c : input)
+                c = "abct\xc3\xa9"[random() % 6];
+            CHECK(literal.match(input) == automaton.match(input));
+            CHECK(literal.search(input) == automaton.search(input));
+            CHECK(literal.find(input) == automaton.find(input));
+        }
+    }
+}
+
+TEST_CASE("amat::program : required substring")
+{
+    CHECK(program{ "(ab)*cd(ef)*" }.analysis().required == "cd");
+    CHECK(program{ "x(abc|abd)y" }.analysis().required == "xab");
+    CHECK(program{ "[ab]c+d" }.analysis().required == "cd");
+    CHECK(program{ "(ab){2}[0-9]" }.analysis().required == "abab");
+    CHECK(program{ "a\\bb" }.analysis().required == "ab");
+    CHECK(program{ "(xbc|abc)" }.analysis().required == "bc");
+    CHECK(program{ "a*|b" }.analysis().required == "");
+    CHECK(program{ "ab{2,3}" }.analysis().longest == 4);
+    CHECK(program{ "ab+" }.analysis().longest ==
+          program::Analysis::unbounded);
+
+    // rejected by the substring scan alone
+    program unbounded{ "[a-z]+@example" };
+    reset_stats();
+    CHECK_FALSE(unbounded.search(std::string(4096, 'x')));
+    if constexpr (stats_enabled)
+        CHECK(thread_stats().prefilter_skips == 4096);
+
+    // only the windows around `cd' are given to the engine
+    program bounded{ "[a-z]{0,3}cd[0-9]" };
+    std::string input(4096, 'x');
+    input.replace(1000, 2, "cd");
+    input.replace(3000, 3, "cd7");
+    reset_stats();
+    CHECK(bounded.search(input));
+    CHECK(bounded.find(input) == Span{ 2997, 3003 });
+    if constexpr (stats_enabled)
+        CHECK(thread_stats().prefilter_skips > 3000);
+
+    // agrees with the search DFA, without the prefilter
+    std::mt19937 random{ 47 };
+    for (auto const* source : { "(ab)*cd(ef)*",
+                                "x(abc|abd)y",
+                                "[ab]c+d",
+                                "(a|b)c{2}",
+                                "a.{0,3}bc",
+                                "(ab|cb)a?" }) {
+        program pattern{ source };
+        REQUIRE(pattern.analysis().required.size());
+        auto dfa =
+          util::construct_DFA_from_bytecode(pattern.search_bytecode()).value();
+        for (auto i = 0; i < 300; i++) {
+            std::string input(random() % 24, 'a');
+            for (auto& c : input)
+                c = "abcdefxy"[random() % 8];
+            CHECK(pattern.search(input) == dfa.search(input));
+        }
+    }
+}
+
+TEST_CASE("amat::util::simplify")
+{
+    auto simplified = [](std::string_view source, bool captures = true) {
+        return postfix_as_string(
+          util::simplify(Parser{ source }.postfix(), captures));
+    };
+    auto ast = util::construct_ast_from_postfix(Parser{ "(ab)*|c" }.postfix());
+    CHECK(ast.nodes.size() == 7);
+    CHECK(ast.type(ast.root) == Item::Type::T_UNION);
+    CHECK(postfix_as_string(util::construct_postfix_from_ast(ast)) ==
+          "ab.)*c|");
+
+    CHECK(simplified("abc|abd|e") == "abcd|..e|");
+    CHECK(simplified("ab|a") == "ab?.");
+    CHECK(simplified("a|ab") == "aab.|");
+    CHECK(simplified("a+*") == "a*");
+    CHECK(simplified("a?+") == "a*");
+    CHECK(simplified("((a)*)*") == "a)*)*");
+    CHECK(simplified("((a)*)*", false) == "a*");
+    // groups are kept apart with captures
+    CHECK(simplified("(a)b|(a)c") == "a)b.a)c.|");
+    CHECK(simplified("(a)b|(a)c", false) == "abc|.");
+    CHECK(simplified("abc|xbc") == "ax|b.c.");
+    CHECK(simplified("(a)c|(b)c") == "a)b)|c.");
+    CHECK(simplified("bc|c") == "b?c.");
+    CHECK(simplified("c|bc") == "cbc.|");
+
+    // patterns past `limits::max_states' reach its check, rather than
+    // overflowing the stack while simplified
+    std::string long_a(300000, 'a');
+    CHECK_THROWS_AS(program{ long_a + "|b" }, std::runtime_error);
+    CHECK_THROWS_AS(program{ long_a + "b|" + long_a + "c" },
+                    std::runtime_error);
+    std::string shared(20000, 'a');
+    program deep{ "x" + shared + "b|x" + shared + "c|" + shared + "bd" };
+    CHECK(deep.match("x" + shared + "c"));
+    CHECK(deep.match(shared + "bd"));
+    CHECK_FALSE(deep.match("x" + shared + "d"));
+
+    // one thread per distinct prefix and suffix of the keywords
+    std::string keywords = "(GET|POST|PUT|PATCH|DELETE|HEAD)[ ]";
+    CHECK(program{ keywords }.bytecode().size() <
+          util::construct_bytecode_from_regular_expression(keywords).size());
+
+    // same language, and with groups the same captures, as the pattern
+    std::mt19937 random{ 48 };
+    for (auto const* source : { "(x|xa|xab)(b*)",
+                                "(ab|ac|a)(c?)",
+                                "((a|b)*)(ab|aa|b)",
+                                "(a(b|c)|a(b|d))+",
+                                "ab+|ab*c|abc",
+                                "(xa|ya|a)(b?)",
+                                "(ab|cb)c|b" }) {
+        program pattern{ source };
+        auto bytecode =
+          util::construct_bytecode_from_regular_expression(source);
+        util::Pike_VM pike_vm{ bytecode };
+        auto dfa = util::construct_DFA_from_bytecode(bytecode).value();
+        for (auto i = 0; i < 300; i++) {
+            std::string input(random() % 8, 'a');
+            for (auto& c : input)
+                c = "abcdx"[random() % 5];
+            std::vector<Span> groups(bytecode.groups);
+            std::vector<Span> expected(bytecode.groups);
+            CHECK(pattern.match(input) == dfa.match(input));
+            CHECK(pattern.match(input, groups) ==
+                  pike_vm.match(input, expected));
+            CHECK(groups == expected);
+        }
+    }
+}
+
+TEST_CASE("amat::find : policies")
+{
+    constexpr auto earliest = Policy::earliest;
+    CHECK(find<"abcd|c", Flags::none, earliest>("xabcd") == Span{ 3, 4 });
+    CHECK(find<"a+", Flags::none, earliest>("baaab") == Span{ 1, 2 });
+    CHECK(find<"a*", Flags::none, earliest>("baaab") == Span{ 0, 0 });
+    CHECK(find<"b$", Flags::none, earliest>("bab") == Span{ 2, 3 });
+    CHECK(find<"x+y", Flags::none, earliest>("axxxy") == Span{ 1, 5 });
+    CHECK_FALSE(find<"\\d+", Flags::none, earliest>("no digits"));
+
+    // literals that end first, the longest of them
+    program keywords{ "GET|GETS|ET|TS" };
+    REQUIRE(keywords.engine() == program::Engine::literal);
+    CHECK(keywords.find("xGETS") == Span{ 1, 5 });
+    CHECK(keywords.find<earliest>("xGETS") == Span{ 1, 4 });
+
+    // no byte after the first match is read
+    program digits{ "[0-9]+" };
+    std::string input = "id 42" + std::string(4096, '7');
+    reset_stats();
+    CHECK(digits.find<earliest>(input) == Span{ 3, 4 });
+    if constexpr (stats_enabled)
+        CHECK(thread_stats().bytes_scanned < 16);
+
+    // nor after the DFA reaches its dead state
+    reset_stats();
+    CHECK_FALSE(program{ "a*|bb" }.match("bx" + std::string(4096, 'b')));
+    if constexpr (stats_enabled)
+        CHECK(thread_stats().bytes_scanned == 2);
+
+    // the match that ends first, from its leftmost start, on every engine
+    std::mt19937 random{ 50 };
+    for (auto const* source :
+         { "ab|b", "a+b?", "(ab|cb)c|b", "[a-c]{2,3}", "a*|c", "x(ab)+" }) {
+        program pattern{ source };
+        program lazy{ source, Flags::none, limits{ .max_dfa_bytes = 0 } };
+        REQUIRE(lazy.search_engine() != program::Engine::dfa);
+        for (auto i = 0; i < 300; i++) {
+            std::string input(random() % 8, 'a');
+            for (auto& c : input)
+                c = "abcx"[random() % 4];
+            std::optional<Span> expected{};
+            for (std::size_t end = 0; end <= input.size() and !expected;
+                 end++) {
+                for (std::size_t begin = 0; begin <= end; begin++) {
+                    if (pattern.match(input.substr(begin, end - begin))) {
+                        expected = Span{ begin, end };
+                        break;
+                    }
+                }
+            }
+            CHECK(pattern.find<earliest>(input) == expected);
+            CHECK(lazy.find<earliest>(input) == expected);
+            CHECK(lazy.find(input) == pattern.find(input));
+        }
+    }
+}
@@ -0,0 +1,14 @@
+#include <amat/amat.h>
+
+#include <string_view>
+
+/**
+ * A second translation unit including the whole library, so the test
+ * binary fails to link when a header defines a non-inline function or
+ * variable.
+ */
+bool
+search_in_unit(std::string_view str)
+{
+    return amat::search<"(ab)+c">(str);
+}
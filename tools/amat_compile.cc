@@ -0,0 +1,191 @@
+#include <amat/amat.h>
+#include <amat/static_dfa.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * amat_compile: determinize regular expressions offline and emit a
+ * header of `amat::static_dfa' tables, so neither the program nor its
+ * build compiles the patterns.
+ *
+ * usage: amat_compile [-n namespace] [-o output] [-i] -f patterns
+ *
+ * Each line of the patterns file is a C++ identifier, whitespace, then
+ * the regular expression up to the end of the line; empty lines and
+ * lines starting with `#' are skipped. Each pattern becomes a struct with
+ * constexpr `match' (whole input) and `search' (anywhere in the input).
+ */
+
+static_assert(amat::static_dfa<1>::dead == amat::util::DFA::dead);
+static_assert(amat::static_dfa<1>::matched == amat::util::DFA::matched);
+
+namespace {
+
+struct Pattern
+{
+    std::string name;
+    std::string source;
+};
+
+[[noreturn]] void
+usage()
+{
+    std::cerr << "usage: amat_compile [-n namespace] [-o output] [-i] "
+                 "-f patterns"
+              << std::endl;
+    std::exit(2);
+}
+
+bool
+is_identifier(std::string const& name)
+{
+    if (name.empty() or std::isdigit(static_cast<unsigned char>(name[0])))
+        return false;
+    for (auto c : name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) and c != '_')
+            return false;
+    }
+    return true;
+}
+
+std::vector<Pattern>
+read_patterns(std::istream& input)
+{
+    std::vector<Pattern> patterns{};
+    std::string line{};
+    for (std::size_t number = 1; std::getline(input, line); number++) {
+        if (line.empty() or line[0] == '#')
+            continue;
+        auto space = line.find_first_of(" \t");
+        auto start = line.find_first_not_of(" \t", space);
+        Pattern pattern{ line.substr(0, space),
+                         start == std::string::npos ? ""
+                                                    : line.substr(start) };
+        if (!is_identifier(pattern.name))
+            throw std::runtime_error("line " + std::to_string(number) +
+                                     ": invalid name `" + pattern.name + "'");
+        patterns.push_back(std::move(pattern));
+    }
+    return patterns;
+}
+
+/**
+ * Quote `source' for a `//' comment. The closing quote keeps a final
+ * backslash from splicing the next line into the comment.
+ */
+std::string
+as_comment(std::string const& source)
+{
+    return "`" + source + "'";
+}
+
+void
+emit_dfa(std::ostream& output,
+         std::string const& name,
+         amat::util::DFA const& dfa)
+{
+    output << "    static constexpr amat::static_dfa<" << dfa.size() << "> "
+           << name << "{\n      { ";
+    for (std::size_t i = 0; i < dfa.table.size(); i++) {
+        output << dfa.table[i] << "u,";
+        output << ((i % 16 == 15) ? "\n        " : " ");
+    }
+    output << "},\n      { ";
+    for (std::size_t state = 0; state < dfa.size(); state++) {
+        output << (dfa.accept[state] ? "true, " : "false, ");
+    }
+    output << "},\n      " << dfa.start << "u\n    };\n";
+}
+
+void
+emit_pattern(std::ostream& output, Pattern const& pattern, amat::Flags flags)
+{
+    amat::program compiled{ pattern.source, flags };
+    auto match = amat::util::construct_DFA_from_bytecode(compiled.bytecode());
+    auto search =
+      amat::util::construct_DFA_from_bytecode(compiled.search_bytecode());
+    if (!match or !search)
+        throw std::runtime_error("pattern `" + pattern.name +
+                                 "' needs more than " +
+                                 std::to_string(amat::util::DFA::max_states) +
+                                 " DFA states");
+
+    output << "\n// " << pattern.name << ": " << as_comment(pattern.source)
+           << "\nstruct " << pattern.name << "\n{\n";
+    emit_dfa(output, "match_dfa", match.value());
+    emit_dfa(output, "search_dfa", search.value());
+    output << "\n"
+              "    static constexpr bool match(std::string_view str) noexcept\n"
+              "    {\n"
+              "        return match_dfa.match(str);\n"
+              "    }\n"
+              "    static constexpr bool search(std::string_view str) noexcept\n"
+              "    {\n"
+              "        return search_dfa.search(str);\n"
+              "    }\n"
+              "};\n";
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+    std::string name_space = "patterns";
+    std::string output_path{};
+    std::string input_path{};
+    amat::Flags flags = amat::Flags::none;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "-i") {
+            flags = flags | amat::Flags::icase;
+        } else if (i + 1 < argc and argument == "-n") {
+            name_space = argv[++i];
+        } else if (i + 1 < argc and argument == "-o") {
+            output_path = argv[++i];
+        } else if (i + 1 < argc and argument == "-f") {
+            input_path = argv[++i];
+        } else {
+            usage();
+        }
+    }
+    if (input_path.empty() or !is_identifier(name_space))
+        usage();
+
+    try {
+        std::ifstream input{ input_path };
+        if (!input)
+            throw std::runtime_error("could not open " + input_path);
+        std::ostringstream output{};
+        output << "// Generated by amat_compile from " << input_path
+               << "; do not edit.\n"
+                  "#pragma once\n\n"
+                  "#include <string_view>\n\n"
+                  "#include <amat/static_dfa.h>\n\n"
+                  "namespace "
+               << name_space << " {\n";
+        for (auto const& pattern : read_patterns(input)) {
+            emit_pattern(output, pattern, flags);
+        }
+        output << "\n} // namespace " << name_space << "\n";
+
+        if (output_path.empty()) {
+            std::cout << output.str();
+        } else {
+            std::ofstream file{ output_path };
+            if (!(file << output.str()))
+                throw std::runtime_error("could not write " + output_path);
+        }
+    } catch (std::exception const& error) {
+        std::cerr << "amat_compile: " << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}